@@ -1,3 +1,4 @@
 set -e
-clang++ -o sdffont -g -O3 -m64 -Wall -Isource source/main.cpp
+clang++ -o sdffont -g -O3 -m64 -Wall -pthread -Isource source/main.cpp
 clang++ -o angelcode2font -g -O3 -m64 -Wall source/angelcode.cpp
+clang++ -o atlas_example -g -O3 -m64 -Wall -pthread -Isource source/atlas_example.cpp source/atlas_example_text.cpp
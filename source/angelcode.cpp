@@ -3,9 +3,11 @@
 #include <stdio.h>
 #include <string.h>
 #include <vector>
+#include <algorithm>
 #include <assert.h>
 
 #include "font.h"
+#include "font_writer.h"
 
 /*
 
@@ -82,133 +84,43 @@ int load_angelcode(const char* path, SFont& font)
 				glyph.offset[1] = yoff;
 				glyph.advance	= advance;
 				glyph.bearing_x = 0;
+				glyph.page		= (uint16_t)page;
 
 				font.glyphs.push_back(glyph);
 			}
 		}
 	}
 
+	fclose(file);
 	return 0;
 }
 
-static uint64_t GetFileOffset(FILE* f)
-{
-	return (uint64_t)ftell(f);
-}
-
-static uint64_t Align8(uint64_t pos)
-{
-	uint64_t remainder = pos & (8 - 1);
-	if( remainder )
-		return pos + 8 - remainder;
-	return pos;
-}
-
-static void AlignFile8(FILE* file)
-{
-	uint64_t pos = GetFileOffset(file);
-	uint64_t nextpos = Align8(pos);
-	uint8_t c = 0;
-	for( uint64_t i = pos; i < nextpos; ++i )
-		fwrite(&c, 1, 1, file);
-}
-
 static int WriteFontInfo(const char* path, SFont& font)
 {
 	std::sort(font.glyphs.begin(), font.glyphs.end());
+	std::sort(font.pairkernings.begin(), font.pairkernings.end());
 
 	SFontHeader header = {};
-	header.magic[0] 			= 'F';
-	header.magic[1] 			= 'O';
-	header.magic[2] 			= 'N';
-	header.magic[3] 			= 'T';
 	header.texturesize_width	= 1024;//font.texturesize[0];
 	header.texturesize_height	= 1024;//font.texturesize[1];
 	header.fontsize				= font.size;
+	header.num_pages			= 1;
+	for( size_t i = 0; i < font.glyphs.size(); ++i )
+		header.num_pages = font.glyphs[i].page >= header.num_pages ? font.glyphs[i].page + 1 : header.num_pages;
 
 	header.line_ascend			= font.lineascend;
 	header.line_descend			= font.linedescend;
 	header.line_gap				= font.linegap;
-	header.num_glyphs			= (uint16_t)font.glyphs.size();
-	header.num_pairkernings		= (uint16_t)font.pairkernings.size();
-
-	// Offsets into the file where to find data (0 based, i.e from beginning of file)
-	uint64_t offset = sizeof(SFontHeader);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-
-	header.codepoints			= offset;
-	offset += header.num_glyphs * sizeof(uint32_t);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-	header.pairkeys				= offset;
-
-	offset += header.num_pairkernings * sizeof(uint64_t);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-
-	header.pairvalues			= offset;
-	offset += header.num_pairkernings * sizeof(float);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-	header.glyphs				= offset;
-
-	FILE* file = fopen(path, "wb");
-	if( !file )
-		return 1;
-
-	fwrite(&header, 1, sizeof(header), file);
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.codepoints );
-
-	for( int i = 0; i < font.glyphs.size(); ++i )
-	{
-		const SFontGlyph& glyph = font.glyphs[i];
-		fwrite( &glyph.codepoint, 1, sizeof(glyph.codepoint), file );
-
-		//printf("%d: codepoint %d  bb %d, %d, %d, %d   adv %d  bx %d\n", i, glyph.codepoint, glyph.box[0], glyph.box[1], glyph.box[2], glyph.box[3], glyph.advance, glyph.bearing_x );
-	}
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.pairkeys );
 
-	for( int i = 0; i < font.pairkernings.size(); ++i )
-	{
-		const SFontPairKerning& pk = font.pairkernings[i];
-		fwrite( &pk.key, 1, sizeof(pk.key), file );
-	}
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.pairvalues );
-
-	for( int i = 0; i < font.pairkernings.size(); ++i )
-	{
-		const SFontPairKerning& pk = font.pairkernings[i];
-
-		fwrite( &pk.kerning, 1, sizeof(pk.kerning), file );
-	}
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.glyphs );
-
-	for( int i = 0; i < font.glyphs.size(); ++i )
-	{
-		const SFontGlyph& glyph = font.glyphs[i];
-		fwrite( &glyph, 1, sizeof(glyph), file);
-	}
-
-	return 0;
+	std::vector<uint8_t> data;
+	FontSerialize(&header, font.glyphs.data(), (uint32_t)font.glyphs.size(), font.pairkernings.data(), (uint32_t)font.pairkernings.size(), 0, 0, 0, 0, data);
+	return FontWriteFile(path, &data[0], data.size());
 }
 
 
 static void Usage()
 {
-	fprintf(stderr, "Usage: angelcode2font <angelcode.ttf_sdf.txt>");
+	fprintf(stderr, "Usage: angelcode2font <angelcode.ttf_sdf.txt> [output.font, or - for stdout]\n");
 }
 
 int main(int argc, const char** argv)
@@ -219,16 +131,23 @@ int main(int argc, const char** argv)
 		return 1;
 	}
 
-	SFont font;
+	SFont font = {};
 
-	load_angelcode(argv[1], font);
+	if( load_angelcode(argv[1], font) )
+		return 1;
 
-	printf("Font size %d\n", font.size);
-	printf("%d glyphs\n", (int)font.glyphs.size());
+	// The messages go to stderr when the font is written to stdout
+	const char* outputpath = argc > 2 ? argv[2] : "test2.font";
+	FILE* log = strcmp(outputpath, "-") == 0 ? stderr : stdout;
+	fprintf(log, "Font size %d\n", font.size);
+	fprintf(log, "%d glyphs\n", (int)font.glyphs.size());
 
-	const char* outputpath = "test2.font";
-	WriteFontInfo(outputpath, font);
+	if( WriteFontInfo(outputpath, font) )
+	{
+		fprintf(stderr, "Failed to write %s\n", outputpath);
+		return 1;
+	}
 
-	printf("Wrote %s\n", outputpath);
+	fprintf(log, "Wrote %s\n", outputpath);
 	return 0;
 }
@@ -0,0 +1,220 @@
+// An example of the runtime glyph atlas (sdf_atlas.h), that also checks its behavior:
+// the dirty rects, the eviction of the least recently used glyphs, and the worker threads.
+//
+//	./atlas_example examples/helsinki.ttf
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define STB_TRUETYPE_IMPLEMENTATION
+#include "stb_truetype.h"
+
+#define SDF_IMPLEMENTATION
+#include "sdf.h"
+
+#define SDF_ATLAS_IMPLEMENTATION
+#include "sdf_atlas.h"
+
+// atlas_example_text.cpp
+float MeasureText(sdf_atlas* atlas, const char* text);
+
+static int g_NumErrors = 0;
+
+#define CHECK(_EXPR)																\
+	if( !(_EXPR) )																	\
+	{																				\
+		fprintf(stderr, "%s:%d: Check failed: %s\n", __FILE__, __LINE__, #_EXPR);	\
+		g_NumErrors++;																\
+	}
+
+static int ReadFile(const char* path, std::vector<unsigned char>& data)
+{
+	FILE* file = fopen(path, "rb");
+	if( !file )
+		return 1;
+	fseek(file, 0, SEEK_END);
+	data.resize((size_t)ftell(file));
+	fseek(file, 0, SEEK_SET);
+	size_t nread = fread(&data[0], 1, data.size(), file);
+	fclose(file);
+	return nread == data.size() ? 0 : 1;
+}
+
+static int IsInside(const sdf_atlas_rect& r, const int box[4])
+{
+	return box[0] >= r.x && box[1] >= r.y && box[2] <= r.x + r.w && box[3] <= r.y + r.h;
+}
+
+static int IsDirty(const sdf_atlas_rect* dirty, int numdirty, const int box[4])
+{
+	for( int i = 0; i < numdirty; ++i )
+	{
+		if( IsInside(dirty[i], box) )
+			return 1;
+	}
+	return 0;
+}
+
+static int CompareBox(const sdf_atlas* a, const sdf_atlas* b, const int box[4])
+{
+	int width, numchannels;
+	const unsigned char* pa = sdf_atlas_pixels(a, &width, 0, &numchannels);
+	const unsigned char* pb = sdf_atlas_pixels(b, 0, 0, 0);
+	for( int y = box[1]; y < box[3]; ++y )
+	{
+		size_t offset = ((size_t)y * width + box[0]) * numchannels;
+		if( memcmp(pa + offset, pb + offset, (size_t)(box[2] - box[0]) * numchannels) != 0 )
+			return 1;
+	}
+	return 0;
+}
+
+// A new glyph is dirty once, and a glyph requested again is not
+static void CheckDirtyRects(sdf_atlas* atlas)
+{
+	sdf_atlas_glyph glyph, again;
+	const sdf_atlas_rect* dirty;
+	CHECK(sdf_atlas_request_glyph(atlas, 'A', &glyph) == SDF_ATLAS_GLYPH_READY);
+	int numdirty = sdf_atlas_flush(atlas, &dirty);
+	CHECK(numdirty == 1 && IsInside(dirty[0], glyph.box));
+
+	CHECK(sdf_atlas_request_glyph(atlas, 'A', &again) == SDF_ATLAS_GLYPH_READY);
+	CHECK(memcmp(glyph.box, again.box, sizeof(glyph.box)) == 0);
+	CHECK(sdf_atlas_flush(atlas, &dirty) == 0);
+
+	// No outline, so no tile
+	CHECK(sdf_atlas_request_glyph(atlas, ' ', &glyph) == SDF_ATLAS_GLYPH_READY);
+	CHECK(glyph.box[0] == glyph.box[2] && glyph.box[1] == glyph.box[3]);
+	CHECK(sdf_atlas_flush(atlas, &dirty) == 0);
+
+	// The glyphs requested from the other source file are the same
+	CHECK(MeasureText(atlas, "AA") == again.advance * 2);
+	CHECK(sdf_atlas_flush(atlas, &dirty) == 0);
+}
+
+// Fills the atlas in one frame: those glyphs cannot be evicted until the flush. The next frame evicts them
+static void CheckEviction(sdf_atlas* atlas)
+{
+	std::vector<int> codepoints;
+	sdf_atlas_glyph glyph;
+	int codepoint = 'B';
+	for( ; codepoint <= 'z'; ++codepoint )
+	{
+		int result = sdf_atlas_request_glyph(atlas, codepoint, &glyph);
+		if( result == SDF_ATLAS_GLYPH_MISSING )
+			break;
+		codepoints.push_back(codepoint);
+	}
+	printf("%d glyphs fit in the atlas\n", (int)codepoints.size());
+	CHECK(codepoint <= 'z');	// The atlas is too large for this check
+	CHECK(!codepoints.empty());
+
+	for( size_t i = 0; i < codepoints.size(); ++i )
+		CHECK(sdf_atlas_request_glyph(atlas, codepoints[i], 0) == SDF_ATLAS_GLYPH_READY);
+	const sdf_atlas_rect* dirty;
+	sdf_atlas_flush(atlas, &dirty);
+
+	// The least recently used glyphs make room for it
+	CHECK(sdf_atlas_request_glyph(atlas, codepoint, &glyph) == SDF_ATLAS_GLYPH_READY);
+	int numdirty = sdf_atlas_flush(atlas, &dirty);
+	CHECK(IsDirty(dirty, numdirty, glyph.box));
+
+	// 'A' was used the longest time ago, so it was evicted, and is generated again
+	CHECK(sdf_atlas_request_glyph(atlas, 'A', &glyph) == SDF_ATLAS_GLYPH_READY);
+	numdirty = sdf_atlas_flush(atlas, &dirty);
+	CHECK(IsDirty(dirty, numdirty, glyph.box));
+}
+
+// The worker threads produce the same tiles as the synchronous atlas, in the same places
+static void CheckWorkers(const sdf_atlas_params* params)
+{
+	sdf_atlas_params threadedparams = *params;
+	threadedparams.numthreads = 2;
+	sdf_atlas* atlas = sdf_atlas_create(params);
+	sdf_atlas* threaded = sdf_atlas_create(&threadedparams);
+
+	const char* text = "Hello, World";
+	int numpending = 0;
+	for( const char* c = text; *c; ++c )
+	{
+		sdf_atlas_request_glyph(atlas, *c, 0);
+		int result = sdf_atlas_request_glyph(threaded, *c, 0);
+		if( strchr(text, *c) == c )		// Once per code point
+			numpending += result == SDF_ATLAS_GLYPH_PENDING;
+	}
+	CHECK(numpending > 0);
+
+	const sdf_atlas_rect* dirty;
+	int numcollected = 0;
+	for( int frame = 0; frame < 10000 && numcollected < numpending; ++frame )
+	{
+		numcollected += sdf_atlas_collect(threaded, 4);
+		sdf_atlas_flush(threaded, &dirty);
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	CHECK(numcollected == numpending);
+
+	for( const char* c = text; *c; ++c )
+	{
+		sdf_atlas_glyph glyph, threadedglyph;
+		CHECK(sdf_atlas_request_glyph(atlas, *c, &glyph) == SDF_ATLAS_GLYPH_READY);
+		CHECK(sdf_atlas_request_glyph(threaded, *c, &threadedglyph) == SDF_ATLAS_GLYPH_READY);
+		CHECK(memcmp(glyph.box, threadedglyph.box, sizeof(glyph.box)) == 0);
+		CHECK(CompareBox(atlas, threaded, glyph.box) == 0);
+	}
+
+	sdf_atlas_destroy(threaded);
+	sdf_atlas_destroy(atlas);
+}
+
+int main(int argc, const char** argv)
+{
+	if( argc < 2 )
+	{
+		fprintf(stderr, "Usage: %s <font.ttf>\n", argv[0]);
+		return 1;
+	}
+
+	std::vector<unsigned char> data;
+	stbtt_fontinfo font;
+	if( ReadFile(argv[1], data) || !stbtt_InitFont(&font, &data[0], stbtt_GetFontOffsetForIndex(&data[0], 0)) )
+	{
+		fprintf(stderr, "Failed to load %s\n", argv[1]);
+		return 1;
+	}
+
+	sdf_atlas_params params;
+	memset(&params, 0, sizeof(params));
+	params.font				= &font;
+	params.fontsize			= 32;
+	params.radius			= 4;
+	params.padding			= 1;
+	params.numoversampling	= 2;
+	params.numchannels		= 1;
+	params.algorithm		= SDF_ALGORITHM_EDT;
+	params.width			= 128;
+	params.height			= 128;
+
+	sdf_atlas* atlas = sdf_atlas_create(&params);
+	CHECK(atlas != 0);
+	if( atlas )
+	{
+		CheckDirtyRects(atlas);
+		CheckEviction(atlas);
+		sdf_atlas_destroy(atlas);
+	}
+	CheckWorkers(&params);
+
+	if( g_NumErrors )
+	{
+		fprintf(stderr, "%d checks failed\n", g_NumErrors);
+		return 1;
+	}
+	printf("All checks passed\n");
+	return 0;
+}
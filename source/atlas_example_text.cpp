@@ -0,0 +1,22 @@
+// A second source file that uses the atlas, so that the example also checks that sdf_atlas.h
+// can be included without the implementation.
+
+#include <stdint.h>
+#include "stb_truetype.h"
+#include "sdf_atlas.h"
+
+// Requests the glyphs of a text, and returns its width in pixels (or -1 if some glyphs are still pending)
+float MeasureText(sdf_atlas* atlas, const char* text)
+{
+	float width = 0.0f;
+	for( const char* c = text; *c; ++c )
+	{
+		sdf_atlas_glyph glyph;
+		int result = sdf_atlas_request_glyph(atlas, *c, &glyph);
+		if( result == SDF_ATLAS_GLYPH_PENDING )
+			return -1.0f;
+		if( result == SDF_ATLAS_GLYPH_READY )
+			width += glyph.advance;
+	}
+	return width;
+}
@@ -1,6 +1,21 @@
 #pragma once
 
+#include <stdint.h>
+
+// 32 bytes. The size of the records in a file is SFontHeader::glyph_size
 struct SFontGlyph
+{
+	uint32_t	codepoint;
+	uint16_t	box[4];		// pixels
+	float		offset[2];	// pixels
+	float		advance;	// pixels
+	float		bearing_x;	// pixels
+	uint16_t	page;		// The atlas texture the box is in
+	uint16_t	_pad;
+};
+
+// 28 bytes. The glyph record of the "FONT" files written before the multi page atlases (SFontHeaderV1::num_pages 0)
+struct SFontGlyphV1
 {
 	uint32_t	codepoint;
 	uint16_t	box[4];		// pixels
@@ -15,7 +30,72 @@ struct SFontPairKerning
 	float		kerning;	// texel coords
 };
 
+enum EFontChannelLayout
+{
+	FONT_LAYOUT_SDF		= 0,	// Single channel distance field
+	FONT_LAYOUT_MSDF	= 1,	// RGB multi channel distance field, sample with median(r, g, b)
+	FONT_LAYOUT_MTSDF	= 2,	// RGB as MSDF, and the true distance field in A
+};
+
+enum EFontTexelFormat
+{
+	FONT_FORMAT_R8		= 0,	// 8 bit unsigned normalized channels
+	FONT_FORMAT_R16		= 1,	// 16 bit unsigned normalized channels
+	FONT_FORMAT_R16F	= 2,	// 16 bit (half) float channels, in the same 0-1 range as the normalized formats
+};
+
+// The size of a channel, in bytes
+static inline uint32_t FontTexelFormatSize(uint32_t format)
+{
+	return format == FONT_FORMAT_R8 ? 1 : 2;
+}
+
+#define FONT_VERSION	2
+
+enum EFontFlags
+{
+	FONT_FLAG_LOOKUP			= 1,	// The lookup table is present
+	FONT_FLAG_KERNING_CLASSES	= 2,	// The kerning classes are present. The pair list is then usually empty
+	FONT_FLAG_ATLAS				= 4,	// The atlas textures are embedded
+};
+
+// Offsets into the file are 0 based, i.e from the beginning of the file, and 8 byte aligned
 struct SFontHeader
+{
+	char		magic[4];		// "FNT2"
+	uint32_t	version;		// FONT_VERSION
+	uint32_t	flags;			// EFontFlags
+	uint32_t	header_size;	// sizeof(SFontHeader). Later versions may add fields at the end
+	uint32_t	texturesize_width;
+	uint32_t	texturesize_height;
+	uint32_t	num_pages;		// Number of atlas textures, all of them texturesize_width x texturesize_height
+	uint32_t	num_glyphs;
+	uint32_t	num_pairkernings;
+	uint16_t	fontsize;		// pixels
+	uint16_t	radius;			// pixels
+	uint8_t		channels;		// Number of channels in the texture
+	uint8_t		layout;			// EFontChannelLayout
+	uint8_t		format;			// EFontTexelFormat of each channel (0 in older files)
+	uint8_t		_pad;
+	float		line_ascend;	// pixels
+	float		line_descend; 	// pixels
+	float		line_gap; 		// pixels
+	// 56 bytes
+	uint64_t	codepoints;		// num_glyphs long list of sorted code points. Used to determine glyph index for a code point
+	uint64_t	pairkeys;		// num_pairkernings long list of codepoint pairs
+	uint64_t	pairvalues;		// num_pairkernings long list of pair kernings (float, pixels)
+	uint64_t	glyphs;			// num_glyphs long list of SFontGlyphs
+	uint64_t	lookup;			// SFontLookup (FONT_FLAG_LOOKUP)
+	uint64_t	kerning;		// SFontKerningClasses (FONT_FLAG_KERNING_CLASSES)
+	// 104 bytes. The first version 2 files end the header here
+	uint64_t	atlas;			// SFontAtlas (FONT_FLAG_ATLAS)
+	// 112 bytes. The files written before the glyph_size field end the header here, and have 32 byte glyph records
+	uint32_t	glyph_size;		// The size of a glyph record, sizeof(SFontGlyph). Later versions may add fields at the end
+	uint32_t	_pad2;
+};
+
+// The original header ("FONT"), limited to 65535 glyphs and pairs. Only read, not written anymore
+struct SFontHeaderV1
 {
 	char		magic[4];
 	uint16_t	texturesize_width;
@@ -27,15 +107,113 @@ struct SFontHeader
 	float		line_gap; 		// pixels
 	uint16_t	num_glyphs;
 	uint16_t	num_pairkernings;
-	uint8_t		_pad[4];
+	uint8_t		channels;		// Number of channels in the texture (0 in old files means 1)
+	uint8_t		layout;			// EFontChannelLayout
+	uint16_t	num_pages;		// Number of atlas textures, all of them texturesize_width x texturesize_height.
+								// 0 in the files written before the pages, which have 28 byte SFontGlyphV1 records. The others have SFontGlyph records
 	// 24 bytes
-	// Offsets into the file where to find data (0 based, i.e from beginning of file)
-	uint64_t	codepoints;		// num_glyphs long list of sorted code points. Used to determine glyph index for a code point
-	uint64_t	pairkeys;		// num_pairkernings long list of codepoint pairs
-	uint64_t	pairvalues;		// num_pairkernings long list of pair kernings (Each value is an unscaled coordinate (int16_t) )
-	uint64_t	glyphs;			// num_glyphs long list of SFontGlyphs
+	uint64_t	codepoints;
+	uint64_t	pairkeys;
+	uint64_t	pairvalues;
+	uint64_t	glyphs;
+	// 64 bytes. The files written before the lookup table end the header here, and have their first table (codepoints) at offset 64.
+	// The fields below are only valid if codepoints is past them
+	uint64_t	lookup;			// SFontLookup, 0 if not present
+	uint64_t	kerning;		// SFontKerningClasses, 0 if not present
+};
+
+#define FONT_LOOKUP_NONE	0xFFFFFFFF
+
+/** Code point -> glyph index table, to avoid searching the code points.
+ * The code points are split into blocks of 256. Each block present in the font has a page of glyph indices,
+ * and page 0 is always the first block (ASCII/Latin-1), so those are a single load.
+ */
+struct SFontLookup
+{
+	uint32_t	num_indices;	// The page index covers the code points below num_indices * 256
+	uint32_t	num_pages;
+	// Followed by uint32_t index[num_indices]: the page of each block (or FONT_LOOKUP_NONE)
+	// and uint32_t pages[num_pages * 256]: the glyph index of each code point (or FONT_LOOKUP_NONE)
+};
+
+/** Pair kerning as a class matrix, to avoid searching the pairs.
+ * Glyphs with the same kerning against all other glyphs share a left class, and the same for the right side.
+ * Class 0 is for glyphs without any kerning on that side, and its row/column is all zeros.
+ * The kerning between glyph indices i and j is values[left[i] * num_right + right[j]]
+ */
+struct SFontKerningClasses
+{
+	uint32_t	num_left;		// Including class 0
+	uint32_t	num_right;
+	// Followed by uint16_t left[num_glyphs], uint16_t right[num_glyphs], and float values[num_left * num_right] (pixels)
+};
+
+enum EFontAtlasCompression
+{
+	FONT_ATLAS_RAW		= 0,	// The texels, ready to upload
+	FONT_ATLAS_LZ4		= 1,	// LZ4 block compressed texels (see jc_lz4.h)
+	FONT_ATLAS_BC4		= 2,	// BC4 (RGTC1) blocks, ready to upload. Single 8 bit channel only (see jc_blockcomp.h)
+	FONT_ATLAS_EAC_R11	= 3,	// ETC2 EAC R11 blocks, ready to upload. Single 8 bit channel only
+};
+
+/** The atlas textures, embedded in the file.
+ * Each page is texturesize_width x texturesize_height texels of 'channels' channels each, row by row from the top.
+ * The 16 bit channels (see EFontTexelFormat) are little endian.
+ * The BC4 and EAC R11 pages are 4x4 blocks of 8 bytes, also row by row from the top
+ */
+struct SFontAtlas
+{
+	uint32_t	compression;	// EFontAtlasCompression
+	uint32_t	_pad;
+	uint64_t	page_size;		// The uncompressed size of a page, in bytes
+	// Followed by SFontAtlasPage pages[num_pages]
 };
 
+struct SFontAtlasPage
+{
+	uint64_t	offset;			// From the start of the SFontAtlas, 8 byte aligned
+	uint64_t	size;			// The size in the file, in bytes
+};
+
+// The number of bytes needed for the lookup table of the (sorted) glyphs
+static inline uint64_t FontLookupSize(const SFontGlyph* glyphs, uint32_t numglyphs)
+{
+	uint32_t numindices = numglyphs ? (glyphs[numglyphs-1].codepoint >> 8) + 1 : 1;
+	uint32_t numpages = 1;
+	for( uint32_t i = 0; i < numglyphs; ++i )
+	{
+		uint32_t block = glyphs[i].codepoint >> 8;
+		if( block != 0 && (i == 0 || block != (glyphs[i-1].codepoint >> 8)) )
+			++numpages;
+	}
+	return sizeof(SFontLookup) + (uint64_t)numindices * sizeof(uint32_t) + (uint64_t)numpages * 256 * sizeof(uint32_t);
+}
+
+// Fills in the lookup table (FontLookupSize bytes) for the (sorted) glyphs
+static inline void FontBuildLookup(const SFontGlyph* glyphs, uint32_t numglyphs, void* out)
+{
+	SFontLookup* lookup = (SFontLookup*)out;
+	lookup->num_indices = numglyphs ? (glyphs[numglyphs-1].codepoint >> 8) + 1 : 1;
+	lookup->num_pages = 1;
+
+	uint32_t* index = (uint32_t*)(lookup + 1);
+	for( uint32_t i = 0; i < lookup->num_indices; ++i )
+		index[i] = FONT_LOOKUP_NONE;
+	index[0] = 0;
+	for( uint32_t i = 0; i < numglyphs; ++i )
+	{
+		uint32_t block = glyphs[i].codepoint >> 8;
+		if( index[block] == FONT_LOOKUP_NONE )
+			index[block] = lookup->num_pages++;
+	}
+
+	uint32_t* pages = index + lookup->num_indices;
+	for( uint32_t i = 0; i < lookup->num_pages * 256; ++i )
+		pages[i] = FONT_LOOKUP_NONE;
+	for( uint32_t i = 0; i < numglyphs; ++i )
+		pages[index[glyphs[i].codepoint >> 8] * 256 + (glyphs[i].codepoint & 255)] = i;
+}
+
 bool operator< (const SFontGlyph& lhs, const SFontGlyph& rhs)
 {
 	return lhs.codepoint < rhs.codepoint;
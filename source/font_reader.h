@@ -0,0 +1,481 @@
+#pragma once
+
+/** Reads .font files, without any allocations or copies
+ *
+ * The file is memory mapped, and all the tables point straight into the mapping:
+ *
+ *	SFontData font;
+ *	int error = FontMap("output.font", &font);
+ *	if( error )
+ *		printf("%s\n", FontErrorString(error));
+ *	for( uint32_t i = 0; i < font.glyphs.size; ++i )
+ *		... font.glyphs[i] ...
+ *	FontUnmap(&font);
+ *
+ * Glyph lookups use the lookup table when the file has one, and search the code points otherwise.
+ * Both the current ("FNT2") and the version 1 ("FONT") files are read. The glyph records are header.glyph_size bytes
+ * apart, and are returned by value: the 28 byte records of the oldest files (SFontGlyphV1) get page 0.
+ * For fonts already in memory (e.g. in a package), use FontParse(data, size, &font) instead.
+ * An embedded atlas is read with FontGetAtlasPage (raw and GPU block pages, no copy) or FontReadAtlasPage (any page, as texels).
+ * The data has to be 8 byte aligned, and stay valid as long as the SFontData is used.
+ */
+
+#include "font.h"
+#include "jc_lz4.h"
+#include "jc_blockcomp.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+template<typename T>
+struct SFontSpan
+{
+	const T*	data;
+	uint32_t	size;
+
+	const T&	operator[](uint32_t i) const	{ return data[i]; }
+	const T*	begin() const					{ return data; }
+	const T*	end() const						{ return data + size; }
+};
+
+// The glyph records, 'stride' bytes apart
+struct SFontGlyphs
+{
+	const uint8_t*	data;
+	uint32_t		size;
+	uint32_t		stride;
+
+	SFontGlyph operator[](uint32_t i) const
+	{
+		SFontGlyph glyph;
+		if( stride < sizeof(SFontGlyph) )
+		{
+			memcpy(&glyph, data + (size_t)i * stride, sizeof(SFontGlyphV1));
+			glyph.page = 0;
+			glyph._pad = 0;
+		}
+		else
+			memcpy(&glyph, data + (size_t)i * stride, sizeof(SFontGlyph));
+		return glyph;
+	}
+};
+
+struct SFontData
+{
+	SFontHeader				header;			// Converted to the current version. header.version is the version of the file
+	SFontSpan<uint32_t>		codepoints;		// Sorted. The glyph for codepoints[i] is glyphs[i]
+	SFontSpan<uint64_t>		pairkeys;		// Sorted, (codepoint2 << 32) | codepoint1
+	SFontSpan<float>		pairvalues;		// The kerning for pairkeys[i]
+	SFontGlyphs				glyphs;
+	SFontSpan<uint32_t>		lookupindex;	// See SFontLookup. Empty if the file has no lookup table
+	SFontSpan<uint32_t>		lookuppages;
+	uint32_t				numrightclasses;	// See SFontKerningClasses. The spans are empty if the file has no class kerning
+	SFontSpan<uint16_t>		leftclasses;
+	SFontSpan<uint16_t>		rightclasses;
+	SFontSpan<float>		kerningvalues;
+	const SFontAtlas*		atlas;			// The embedded atlas, or 0
+	SFontSpan<SFontAtlasPage>	atlaspages;
+
+	const void*				mapping;		// Set by FontMap
+	size_t					mappingsize;
+};
+
+enum EFontError
+{
+	FONT_OK = 0,
+	FONT_ERROR_OPEN,		// The file couldn't be opened or mapped
+	FONT_ERROR_ALIGNMENT,	// The data isn't 8 byte aligned
+	FONT_ERROR_SIZE,		// Too small for the header
+	FONT_ERROR_MAGIC,		// Not a .font file
+	FONT_ERROR_VERSION,		// An unknown version, or glyph records smaller than SFontGlyph
+	FONT_ERROR_OFFSET,		// A table is misaligned, overlaps the header, or extends past the end of the file
+	FONT_ERROR_LOOKUP,		// The lookup table points outside of the glyphs
+	FONT_ERROR_KERNING,		// The kerning classes point outside of the matrix
+	FONT_ERROR_ATLAS,		// The embedded atlas is invalid, or a page failed to decompress
+};
+
+static inline const char* FontErrorString(int error)
+{
+	switch( error )
+	{
+	case FONT_OK:				return "ok";
+	case FONT_ERROR_OPEN:		return "failed to open the file";
+	case FONT_ERROR_ALIGNMENT:	return "the data isn't 8 byte aligned";
+	case FONT_ERROR_SIZE:		return "the file is too small";
+	case FONT_ERROR_MAGIC:		return "not a .font file";
+	case FONT_ERROR_VERSION:	return "unknown or unsupported version";
+	case FONT_ERROR_OFFSET:		return "a table is outside of the file";
+	case FONT_ERROR_LOOKUP:		return "the lookup table is invalid";
+	case FONT_ERROR_KERNING:	return "the kerning classes are invalid";
+	case FONT_ERROR_ATLAS:		return "the atlas is invalid";
+	default:					return "unknown error";
+	}
+}
+
+// The version 1 header of the files written before the lookup field was added
+#define _FONT_V1_MIN_HEADER_SIZE	offsetof(SFontHeaderV1, lookup)
+// The version 2 header of the files written before the atlas field was added
+#define _FONT_V2_MIN_HEADER_SIZE	offsetof(SFontHeader, atlas)
+
+// Checks that 'count' items of 'itemsize' bytes at 'offset' are after the header, and within the file, without overflowing
+static inline int _FontCheckTable(uint64_t offset, uint64_t count, uint64_t itemsize, uint64_t headersize, uint64_t size)
+{
+	if( count == 0 )
+		return 1;
+	if( (offset & 7) != 0 || offset < headersize || offset > size )
+		return 0;
+	return count <= (size - offset) / itemsize;
+}
+
+template<typename T>
+static inline void _FontSetSpan(SFontSpan<T>* span, const void* data, uint64_t offset, uint32_t count)
+{
+	span->data = count ? (const T*)((const uint8_t*)data + offset) : 0;
+	span->size = count;
+}
+
+// Reads the header of any version into the current layout. Returns an EFontError
+static inline int _FontReadHeader(const void* data, size_t size, SFontHeader* header, uint64_t* headersize)
+{
+	memset(header, 0, sizeof(SFontHeader));
+	if( size < 4 )
+		return FONT_ERROR_SIZE;
+
+	if( memcmp(data, "FNT2", 4) == 0 )
+	{
+		if( size < offsetof(SFontHeader, texturesize_width) )
+			return FONT_ERROR_SIZE;
+		const SFontHeader* h = (const SFontHeader*)data;
+		if( h->version < 2 )
+			return FONT_ERROR_VERSION;
+		if( h->header_size < _FONT_V2_MIN_HEADER_SIZE || h->header_size > size )
+			return FONT_ERROR_SIZE;
+		// The fields not in the file stay 0
+		memcpy(header, h, h->header_size < sizeof(SFontHeader) ? h->header_size : sizeof(SFontHeader));
+		if( h->header_size < offsetof(SFontHeader, glyph_size) + sizeof(header->glyph_size) )
+			header->glyph_size = sizeof(SFontGlyph);
+		if( header->glyph_size < sizeof(SFontGlyph) || (header->glyph_size & 3) != 0 )
+			return FONT_ERROR_VERSION;
+		*headersize = h->header_size;
+		return FONT_OK;
+	}
+
+	if( memcmp(data, "FONT", 4) != 0 )
+		return FONT_ERROR_MAGIC;
+	if( size < _FONT_V1_MIN_HEADER_SIZE )
+		return FONT_ERROR_SIZE;
+
+	const SFontHeaderV1* h = (const SFontHeaderV1*)data;
+	memcpy(header->magic, h->magic, sizeof(header->magic));
+	header->version				= 1;
+	header->header_size			= _FONT_V1_MIN_HEADER_SIZE;
+	header->texturesize_width	= h->texturesize_width;
+	header->texturesize_height	= h->texturesize_height;
+	header->num_pages			= h->num_pages ? h->num_pages : 1;
+	header->num_glyphs			= h->num_glyphs;
+	header->num_pairkernings	= h->num_pairkernings;
+	header->fontsize			= h->fontsize;
+	header->radius				= h->radius;
+	header->channels			= h->channels ? h->channels : 1;
+	header->layout				= h->layout;
+	header->line_ascend			= h->line_ascend;
+	header->line_descend		= h->line_descend;
+	header->line_gap			= h->line_gap;
+	header->codepoints			= h->codepoints;
+	header->pairkeys			= h->pairkeys;
+	header->pairvalues			= h->pairvalues;
+	header->glyphs				= h->glyphs;
+	// Written before the glyphs had a page index, the records are 28 bytes, and the atlas is a single texture
+	header->glyph_size			= h->num_pages ? sizeof(SFontGlyph) : sizeof(SFontGlyphV1);
+
+	// The lookup and kerning fields are only there if the first table is after them
+	if( size >= sizeof(SFontHeaderV1) && h->codepoints >= sizeof(SFontHeaderV1) )
+	{
+		header->header_size		= sizeof(SFontHeaderV1);
+		header->lookup			= h->lookup;
+		header->kerning			= h->kerning;
+		header->flags			= (h->lookup ? FONT_FLAG_LOOKUP : 0) | (h->kerning ? FONT_FLAG_KERNING_CLASSES : 0);
+	}
+	*headersize = header->header_size;
+	return FONT_OK;
+}
+
+/** Validates the header and the table bounds, and points the spans into 'data'. Returns an EFontError
+ */
+static inline int FontParse(const void* data, size_t size, SFontData* font)
+{
+	memset(font, 0, sizeof(SFontData));
+	if( ((uintptr_t)data & 7) != 0 )
+		return FONT_ERROR_ALIGNMENT;
+
+	uint64_t headersize;
+	int error = _FontReadHeader(data, size, &font->header, &headersize);
+	if( error )
+		return error;
+
+	const SFontHeader* header = &font->header;
+	if( !_FontCheckTable(header->codepoints, header->num_glyphs, sizeof(uint32_t), headersize, size) ||
+		!_FontCheckTable(header->pairkeys, header->num_pairkernings, sizeof(uint64_t), headersize, size) ||
+		!_FontCheckTable(header->pairvalues, header->num_pairkernings, sizeof(float), headersize, size) ||
+		!_FontCheckTable(header->glyphs, header->num_glyphs, header->glyph_size, headersize, size) )
+		return FONT_ERROR_OFFSET;
+
+	_FontSetSpan(&font->codepoints, data, header->codepoints, header->num_glyphs);
+	_FontSetSpan(&font->pairkeys, data, header->pairkeys, header->num_pairkernings);
+	_FontSetSpan(&font->pairvalues, data, header->pairvalues, header->num_pairkernings);
+	font->glyphs.data	= header->num_glyphs ? (const uint8_t*)data + header->glyphs : 0;
+	font->glyphs.size	= header->num_glyphs;
+	font->glyphs.stride	= header->glyph_size;
+
+	if( header->flags & FONT_FLAG_LOOKUP )
+	{
+		if( !_FontCheckTable(header->lookup, 1, sizeof(SFontLookup), headersize, size) )
+			return FONT_ERROR_OFFSET;
+		const SFontLookup* lookup = (const SFontLookup*)((const uint8_t*)data + header->lookup);
+		uint64_t tables = header->lookup + sizeof(SFontLookup);
+		if( lookup->num_indices == 0 || lookup->num_pages == 0 ||
+			lookup->num_indices > (size - tables) / sizeof(uint32_t) ||
+			(uint64_t)lookup->num_pages * 256 > (size - tables) / sizeof(uint32_t) - lookup->num_indices )
+			return FONT_ERROR_OFFSET;
+
+		_FontSetSpan(&font->lookupindex, data, tables, lookup->num_indices);
+		_FontSetSpan(&font->lookuppages, data, tables + lookup->num_indices * sizeof(uint32_t), lookup->num_pages * 256);
+
+		// Checked once here, so the lookups don't have to
+		if( font->lookupindex[0] != 0 )
+			return FONT_ERROR_LOOKUP;
+		for( uint32_t i = 0; i < font->lookupindex.size; ++i )
+		{
+			if( font->lookupindex[i] != FONT_LOOKUP_NONE && font->lookupindex[i] >= lookup->num_pages )
+				return FONT_ERROR_LOOKUP;
+		}
+		for( uint32_t i = 0; i < font->lookuppages.size; ++i )
+		{
+			if( font->lookuppages[i] != FONT_LOOKUP_NONE && font->lookuppages[i] >= header->num_glyphs )
+				return FONT_ERROR_LOOKUP;
+		}
+	}
+
+	if( header->flags & FONT_FLAG_KERNING_CLASSES )
+	{
+		if( !_FontCheckTable(header->kerning, 1, sizeof(SFontKerningClasses), headersize, size) )
+			return FONT_ERROR_OFFSET;
+		const SFontKerningClasses* classes = (const SFontKerningClasses*)((const uint8_t*)data + header->kerning);
+		uint64_t tables = header->kerning + sizeof(SFontKerningClasses);
+		uint64_t numvalues = (uint64_t)classes->num_left * classes->num_right;
+		if( classes->num_left == 0 || classes->num_right == 0 || numvalues > 0xFFFFFFFF ||
+			(uint64_t)header->num_glyphs * 2 * sizeof(uint16_t) + numvalues * sizeof(float) > size - tables )
+			return FONT_ERROR_OFFSET;
+
+		font->numrightclasses = classes->num_right;
+		_FontSetSpan(&font->leftclasses, data, tables, header->num_glyphs);
+		_FontSetSpan(&font->rightclasses, data, tables + header->num_glyphs * sizeof(uint16_t), header->num_glyphs);
+		_FontSetSpan(&font->kerningvalues, data, tables + header->num_glyphs * 2 * sizeof(uint16_t), (uint32_t)numvalues);
+		for( uint32_t i = 0; i < header->num_glyphs; ++i )
+		{
+			if( font->leftclasses[i] >= classes->num_left || font->rightclasses[i] >= classes->num_right )
+				return FONT_ERROR_KERNING;
+		}
+	}
+
+	if( header->flags & FONT_FLAG_ATLAS )
+	{
+		if( !_FontCheckTable(header->atlas, 1, sizeof(SFontAtlas), headersize, size) )
+			return FONT_ERROR_OFFSET;
+		const SFontAtlas* atlas = (const SFontAtlas*)((const uint8_t*)data + header->atlas);
+		uint64_t tables = header->atlas + sizeof(SFontAtlas);
+		if( !_FontCheckTable(tables, header->num_pages, sizeof(SFontAtlasPage), headersize, size) )
+			return FONT_ERROR_OFFSET;
+		int blocks = atlas->compression == FONT_ATLAS_BC4 || atlas->compression == FONT_ATLAS_EAC_R11;
+		if( atlas->compression > FONT_ATLAS_EAC_R11 || header->format > FONT_FORMAT_R16F || (blocks && (header->channels != 1 || header->format != FONT_FORMAT_R8)) ||
+			atlas->page_size != (uint64_t)header->texturesize_width * header->texturesize_height * header->channels * FontTexelFormatSize(header->format) )
+			return FONT_ERROR_ATLAS;
+		uint64_t blocksize = jc_blockcomp_size(header->texturesize_width, header->texturesize_height);
+
+		font->atlas = atlas;
+		_FontSetSpan(&font->atlaspages, data, tables, header->num_pages);
+		for( uint32_t i = 0; i < header->num_pages; ++i )
+		{
+			// LZ4 pages that don't compress are stored raw
+			const SFontAtlasPage& page = font->atlaspages[i];
+			if( blocks ? page.size != blocksize :
+				(page.size == 0 || page.size > atlas->page_size || (page.size != atlas->page_size && atlas->compression == FONT_ATLAS_RAW)) )
+				return FONT_ERROR_ATLAS;
+			if( page.offset > size - header->atlas || !_FontCheckTable(header->atlas + page.offset, page.size, 1, headersize, size) )
+				return FONT_ERROR_OFFSET;
+		}
+	}
+	return FONT_OK;
+}
+
+/** Returns an embedded atlas page as it can be uploaded (atlaspages[page].size bytes): the texels of raw pages,
+ * or the blocks of BC4 and EAC R11 pages.
+ * Returns 0 if it's LZ4 compressed (or there is no such page), and FontReadAtlasPage has to be used.
+ */
+static inline const uint8_t* FontGetAtlasPage(const SFontData* font, uint32_t page)
+{
+	if( !font->atlas || page >= font->atlaspages.size )
+		return 0;
+	if( font->atlas->compression == FONT_ATLAS_LZ4 && font->atlaspages[page].size != font->atlas->page_size )
+		return 0;
+	return (const uint8_t*)font->atlas + font->atlaspages[page].offset;
+}
+
+/** Decompresses (or copies) an embedded atlas page into 'out', which has room for page_size bytes of texels. Returns an EFontError.
+ * The BC4 and EAC R11 blocks are decoded, e.g. for when the GPU doesn't support the format.
+ */
+static inline int FontReadAtlasPage(const SFontData* font, uint32_t page, void* out)
+{
+	if( !font->atlas || page >= font->atlaspages.size )
+		return FONT_ERROR_ATLAS;
+	const SFontAtlasPage& p = font->atlaspages[page];
+	const uint8_t* data = (const uint8_t*)font->atlas + p.offset;
+	if( font->atlas->compression == FONT_ATLAS_BC4 || font->atlas->compression == FONT_ATLAS_EAC_R11 )
+	{
+		jc_blockcomp_decode(font->atlas->compression == FONT_ATLAS_BC4 ? JC_BLOCKCOMP_BC4 : JC_BLOCKCOMP_EAC_R11, data,
+							(int)font->header.texturesize_width, (int)font->header.texturesize_height, (uint8_t*)out);
+		return FONT_OK;
+	}
+	if( p.size == font->atlas->page_size )
+	{
+		memcpy(out, data, p.size);
+		return FONT_OK;
+	}
+	size_t n = jc_lz4_decompress(data, p.size, (uint8_t*)out, font->atlas->page_size);
+	return n == font->atlas->page_size ? FONT_OK : FONT_ERROR_ATLAS;
+}
+
+/** Maps the file read only, and parses it. Returns an EFontError.
+ * On success, the mapping is released with FontUnmap.
+ */
+static inline int FontMap(const char* path, SFontData* font)
+{
+	memset(font, 0, sizeof(SFontData));
+	int fd = open(path, O_RDONLY);
+	if( fd < 0 )
+		return FONT_ERROR_OPEN;
+
+	struct stat st;
+	if( fstat(fd, &st) != 0 || st.st_size <= 0 )
+	{
+		close(fd);
+		return st.st_size == 0 ? FONT_ERROR_SIZE : FONT_ERROR_OPEN;
+	}
+
+	size_t size = (size_t)st.st_size;
+	void* mapping = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);	// The mapping keeps the file open
+	if( mapping == MAP_FAILED )
+		return FONT_ERROR_OPEN;
+
+	int error = FontParse(mapping, size, font);
+	if( error )
+	{
+		munmap(mapping, size);
+		return error;
+	}
+	font->mapping		= mapping;
+	font->mappingsize	= size;
+	return FONT_OK;
+}
+
+static inline void FontUnmap(SFontData* font)
+{
+	if( font->mapping )
+		munmap((void*)font->mapping, font->mappingsize);
+	memset(font, 0, sizeof(SFontData));
+}
+
+/** Returns the index of the glyph for the code point, or FONT_LOOKUP_NONE if it's not in the font
+ */
+static inline uint32_t FontFindGlyphIndex(const SFontData* font, uint32_t codepoint)
+{
+	if( font->lookuppages.size )
+	{
+		uint32_t index;
+		if( codepoint < 256 )
+			index = font->lookuppages[codepoint];
+		else
+		{
+			uint32_t block = codepoint >> 8;
+			uint32_t page = block < font->lookupindex.size ? font->lookupindex[block] : FONT_LOOKUP_NONE;
+			index = page != FONT_LOOKUP_NONE ? font->lookuppages[page * 256 + (codepoint & 255)] : FONT_LOOKUP_NONE;
+		}
+		return index;
+	}
+
+	// Older files: search the code points
+	uint32_t first = 0;
+	uint32_t count = font->codepoints.size;
+	while( count > 0 )
+	{
+		uint32_t half = count / 2;
+		if( font->codepoints[first + half] < codepoint )
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+			count = half;
+	}
+	if( first < font->codepoints.size && font->codepoints[first] == codepoint )
+		return first;
+	return FONT_LOOKUP_NONE;
+}
+
+/** Gets the glyph for the code point. Returns 0 if it's not in the font
+ */
+static inline int FontFindGlyph(const SFontData* font, uint32_t codepoint, SFontGlyph* glyph)
+{
+	uint32_t index = FontFindGlyphIndex(font, codepoint);
+	if( index == FONT_LOOKUP_NONE )
+		return 0;
+	*glyph = font->glyphs[index];
+	return 1;
+}
+
+/** Returns the kerning between two glyphs (indices into font->glyphs), or 0.
+ * Only available if the file has class kerning (font->kerningvalues isn't empty)
+ */
+static inline float FontGetGlyphKerning(const SFontData* font, uint32_t glyph1, uint32_t glyph2)
+{
+	return font->kerningvalues[font->leftclasses[glyph1] * font->numrightclasses + font->rightclasses[glyph2]];
+}
+
+/** Returns the kerning between two code points (pixels), or 0.
+ * The class matrix is used when the file has one, since the pair list is then usually empty
+ */
+static inline float FontGetKerning(const SFontData* font, uint32_t codepoint1, uint32_t codepoint2)
+{
+	if( font->kerningvalues.size )
+	{
+		uint32_t glyph1 = FontFindGlyphIndex(font, codepoint1);
+		uint32_t glyph2 = FontFindGlyphIndex(font, codepoint2);
+		if( glyph1 == FONT_LOOKUP_NONE || glyph2 == FONT_LOOKUP_NONE )
+			return 0.0f;
+		return FontGetGlyphKerning(font, glyph1, glyph2);
+	}
+
+	// Search the pairs
+	uint64_t key = ((uint64_t)codepoint2 << 32) | codepoint1;
+	uint32_t first = 0;
+	uint32_t count = font->pairkeys.size;
+	while( count > 0 )
+	{
+		uint32_t half = count / 2;
+		if( font->pairkeys[first + half] < key )
+		{
+			first += half + 1;
+			count -= half + 1;
+		}
+		else
+			count = half;
+	}
+	if( first < font->pairkeys.size && font->pairkeys[first] == key )
+		return font->pairvalues[first];
+	return 0.0f;
+}
@@ -0,0 +1,174 @@
+#pragma once
+
+/** Writes .font files
+ *
+ * The whole file is laid out in one buffer, which is then written with a single write:
+ *
+ *	SFontHeader header = {};
+ *	header.fontsize = ...;		// The caller sets the font info, the counts, offsets and flags are set here
+ *	std::vector<uint8_t> data;
+ *	FontSerialize(&header, glyphs, numglyphs, pairkernings, numpairkernings, kerningclasses, kerningclassessize, atlas, atlassize, data);
+ *	FontWriteFile("output.font", &data[0], data.size());	// "-" writes to stdout
+ *
+ * The glyphs must be sorted on code point, and the pairs on key.
+ * The optional atlas section is built with FontBuildAtlas().
+ * The buffer can also be used directly, e.g. with FontParse() from font_reader.h.
+ */
+
+#include "font.h"
+#include "jc_lz4.h"
+#include "jc_blockcomp.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+static inline uint64_t _FontAlign8(uint64_t pos)
+{
+	return (pos + 7) & ~(uint64_t)7;
+}
+
+/** Builds the atlas section (see SFontAtlas) from the pages (width x height x channels texels, in the EFontTexelFormat 'format'), in 'out'.
+ * LZ4 pages that don't get smaller are stored raw, so the reader has to check the page size.
+ * BC4 and EAC R11 need a single 8 bit channel, and are encoded with the given quality
+ */
+static inline void FontBuildAtlas(const uint8_t* const* pages, uint32_t numpages, int width, int height, int channels, EFontTexelFormat format,
+								EFontAtlasCompression compression, jc_blockcomp_quality quality, std::vector<uint8_t>& out)
+{
+	uint64_t pagesize = (uint64_t)width * height * channels * FontTexelFormatSize(format);
+	uint64_t offset = _FontAlign8(sizeof(SFontAtlas) + numpages * sizeof(SFontAtlasPage));
+	out.assign(offset, 0);
+	SFontAtlas atlas = {};
+	atlas.compression	= compression;
+	atlas.page_size		= pagesize;
+	memcpy(&out[0], &atlas, sizeof(atlas));
+
+	int blocks = compression == FONT_ATLAS_BC4 || compression == FONT_ATLAS_EAC_R11;
+	std::vector<uint8_t> compressed(compression == FONT_ATLAS_LZ4 ? jc_lz4_compress_bound(pagesize) : (blocks ? jc_blockcomp_size(width, height) : 0));
+	for( uint32_t p = 0; p < numpages; ++p )
+	{
+		const uint8_t* data = pages[p];
+		uint64_t size = pagesize;
+		if( compression == FONT_ATLAS_LZ4 )
+		{
+			size_t compressedsize = jc_lz4_compress(pages[p], pagesize, &compressed[0], pagesize - 1);
+			if( compressedsize )
+			{
+				data = &compressed[0];
+				size = compressedsize;
+			}
+		}
+		else if( blocks )
+		{
+			jc_blockcomp_encode(compression == FONT_ATLAS_BC4 ? JC_BLOCKCOMP_BC4 : JC_BLOCKCOMP_EAC_R11, pages[p], width, height, quality, &compressed[0]);
+			data = &compressed[0];
+			size = compressed.size();
+		}
+
+		SFontAtlasPage page;
+		page.offset	= offset;
+		page.size	= size;
+		memcpy(&out[sizeof(SFontAtlas) + p * sizeof(SFontAtlasPage)], &page, sizeof(page));
+
+		offset = _FontAlign8(offset + size);
+		out.resize(offset, 0);
+		memcpy(&out[page.offset], data, size);
+	}
+}
+
+/** Builds the file in 'out'. The kerning classes (see SFontKerningClasses) and the atlas (see FontBuildAtlas) are optional (pass 0 bytes).
+ */
+static inline void FontSerialize(SFontHeader* header, const SFontGlyph* glyphs, uint32_t numglyphs, const SFontPairKerning* pairkernings, uint32_t numpairkernings,
+								const void* kerningclasses, size_t kerningclassessize, const void* atlas, size_t atlassize, std::vector<uint8_t>& out)
+{
+	memcpy(header->magic, "FNT2", 4);
+	header->version				= FONT_VERSION;
+	header->flags				= FONT_FLAG_LOOKUP | (kerningclassessize ? FONT_FLAG_KERNING_CLASSES : 0) | (atlassize ? FONT_FLAG_ATLAS : 0);
+	header->header_size			= sizeof(SFontHeader);
+	header->glyph_size			= sizeof(SFontGlyph);
+	header->num_glyphs			= numglyphs;
+	header->num_pairkernings	= numpairkernings;
+
+	// Offsets into the file where to find data (0 based, i.e from beginning of file)
+	uint64_t lookupsize = FontLookupSize(glyphs, numglyphs);
+	uint64_t offset = _FontAlign8(sizeof(SFontHeader));
+	header->codepoints			= offset;
+	offset = _FontAlign8(offset + numglyphs * sizeof(uint32_t));
+	header->pairkeys			= offset;
+	offset = _FontAlign8(offset + numpairkernings * sizeof(uint64_t));
+	header->pairvalues			= offset;
+	offset = _FontAlign8(offset + numpairkernings * sizeof(float));
+	header->glyphs				= offset;
+	offset = _FontAlign8(offset + numglyphs * sizeof(SFontGlyph));
+	header->lookup				= offset;
+	offset += lookupsize;
+	header->kerning				= 0;
+	if( kerningclassessize )
+	{
+		offset = _FontAlign8(offset);
+		header->kerning			= offset;
+		offset += kerningclassessize;
+	}
+	header->atlas				= 0;
+	if( atlassize )
+	{
+		offset = _FontAlign8(offset);
+		header->atlas			= offset;
+		offset += atlassize;
+	}
+
+	// The padding is zeroed here
+	out.assign(offset, 0);
+	uint8_t* data = &out[0];
+	memcpy(data, header, sizeof(SFontHeader));
+
+	uint32_t* codepoints = (uint32_t*)(data + header->codepoints);
+	for( uint32_t i = 0; i < numglyphs; ++i )
+		codepoints[i] = glyphs[i].codepoint;
+
+	uint64_t* pairkeys = (uint64_t*)(data + header->pairkeys);
+	float* pairvalues = (float*)(data + header->pairvalues);
+	for( uint32_t i = 0; i < numpairkernings; ++i )
+	{
+		pairkeys[i]		= pairkernings[i].key;
+		pairvalues[i]	= pairkernings[i].kerning;
+	}
+
+	if( numglyphs )
+		memcpy(data + header->glyphs, glyphs, numglyphs * sizeof(SFontGlyph));
+	FontBuildLookup(glyphs, numglyphs, data + header->lookup);
+	if( kerningclassessize )
+		memcpy(data + header->kerning, kerningclasses, kerningclassessize);
+	if( atlassize )
+		memcpy(data + header->atlas, atlas, atlassize);
+}
+
+/** Writes the data to a file, or to stdout if the path is "-". Returns non zero on failure
+ */
+static inline int FontWriteFile(const char* path, const void* data, size_t size)
+{
+	int tostdout = strcmp(path, "-") == 0;
+	int fd = tostdout ? STDOUT_FILENO : open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if( fd < 0 )
+		return 1;
+
+	// A single write, unless it is interrupted, or the output is a pipe
+	const uint8_t* p = (const uint8_t*)data;
+	while( size )
+	{
+		ssize_t n = write(fd, p, size);
+		if( n < 0 && errno == EINTR )
+			continue;
+		if( n <= 0 )
+			break;
+		p += n;
+		size -= (size_t)n;
+	}
+
+	if( !tostdout && close(fd) != 0 )
+		return 1;
+	return size != 0;
+}
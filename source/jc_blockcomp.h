@@ -0,0 +1,354 @@
+#pragma once
+
+/** Single channel GPU block compression: BC4 (RGTC1, desktop) and ETC2 EAC R11 (mobile)
+ *
+ * Both formats store 4x4 texels in 8 bytes (half of an 8 bit texture), and distance fields compress well with them,
+ * since most blocks are either flat (0 or 255), or a smooth gradient.
+ *
+ *	size_t size = jc_blockcomp_size(width, height);
+ *	jc_blockcomp_encode(JC_BLOCKCOMP_BC4, texels, width, height, JC_BLOCKCOMP_QUALITY_NORMAL, blocks);
+ *	jc_blockcomp_decode(JC_BLOCKCOMP_BC4, blocks, width, height, texels);
+ *
+ * The blocks are stored row by row from the top, and the edge blocks are padded by repeating the last row/column.
+ * Quality:
+ *	FAST	BC4: min/max endpoints. EAC: the best base and multiplier per table, from the min/max
+ *	NORMAL	BC4: also tries the 6 value mode, with 0 and 255 as explicit values. EAC: also tries the neighbouring multipliers
+ *	BEST	BC4: searches around the endpoints. EAC: searches around the base and multiplier
+ *
+ * The functions are static, since this is also included by the runtime reader (font_reader.h)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+typedef enum _jc_blockcomp_format
+{
+	JC_BLOCKCOMP_BC4,
+	JC_BLOCKCOMP_EAC_R11,
+} jc_blockcomp_format;
+
+typedef enum _jc_blockcomp_quality
+{
+	JC_BLOCKCOMP_QUALITY_FAST,
+	JC_BLOCKCOMP_QUALITY_NORMAL,
+	JC_BLOCKCOMP_QUALITY_BEST,
+} jc_blockcomp_quality;
+
+static inline size_t jc_blockcomp_size(int width, int height)
+{
+	return (size_t)((width + 3) / 4) * (size_t)((height + 3) / 4) * 8;
+}
+
+// BC4 ********************************************************************************
+
+// The 8 values of the palette. r0 > r1 interpolates 6 values, otherwise 4 are interpolated, and 0 and 255 are added
+static inline void _jc_bc4_palette(int r0, int r1, int* palette)
+{
+	palette[0] = r0;
+	palette[1] = r1;
+	if( r0 > r1 )
+	{
+		for( int i = 1; i < 7; ++i )
+			palette[i + 1] = ((7 - i) * r0 + i * r1 + 3) / 7;
+	}
+	else
+	{
+		for( int i = 1; i < 5; ++i )
+			palette[i + 1] = ((5 - i) * r0 + i * r1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+// Picks the closest palette value for each texel. Returns the squared error
+static inline int _jc_bc4_fit(const uint8_t* texels, int r0, int r1, uint8_t* indices)
+{
+	int palette[8];
+	_jc_bc4_palette(r0, r1, palette);
+	int error = 0;
+	for( int i = 0; i < 16; ++i )
+	{
+		int best = 0;
+		int besterror = 0x7FFFFFFF;
+		for( int p = 0; p < 8; ++p )
+		{
+			int d = palette[p] - texels[i];
+			if( d * d < besterror )
+			{
+				besterror = d * d;
+				best = p;
+			}
+		}
+		indices[i] = (uint8_t)best;
+		error += besterror;
+	}
+	return error;
+}
+
+static inline void _jc_bc4_write(int r0, int r1, const uint8_t* indices, uint8_t* out)
+{
+	uint64_t bits = 0;
+	for( int i = 0; i < 16; ++i )
+		bits |= (uint64_t)indices[i] << (3 * i);
+	out[0] = (uint8_t)r0;
+	out[1] = (uint8_t)r1;
+	for( int i = 0; i < 6; ++i )
+		out[2 + i] = (uint8_t)(bits >> (8 * i));
+}
+
+// Tries the endpoints, and keeps them if they're better
+static inline void _jc_bc4_try(const uint8_t* texels, int r0, int r1, int* besterror, int* best0, int* best1, uint8_t* bestindices)
+{
+	if( r0 < 0 || r0 > 255 || r1 < 0 || r1 > 255 )
+		return;
+	uint8_t indices[16];
+	int error = _jc_bc4_fit(texels, r0, r1, indices);
+	if( error < *besterror )
+	{
+		*besterror = error;
+		*best0 = r0;
+		*best1 = r1;
+		memcpy(bestindices, indices, 16);
+	}
+}
+
+// Encodes 16 texels (row by row) into 8 bytes
+static inline void jc_bc4_encode_block(const uint8_t* texels, jc_blockcomp_quality quality, uint8_t* out)
+{
+	int lo = 255, hi = 0;
+	int innerlo = 255, innerhi = 0;	// Excluding 0 and 255
+	for( int i = 0; i < 16; ++i )
+	{
+		int v = texels[i];
+		lo = v < lo ? v : lo;
+		hi = v > hi ? v : hi;
+		if( v != 0 && v != 255 )
+		{
+			innerlo = v < innerlo ? v : innerlo;
+			innerhi = v > innerhi ? v : innerhi;
+		}
+	}
+
+	uint8_t indices[16];
+	int besterror = 0x7FFFFFFF;
+	int r0 = hi, r1 = lo;
+	if( lo == hi )
+	{
+		// Flat, all indices 0
+		memset(indices, 0, sizeof(indices));
+		_jc_bc4_write(hi, lo, indices, out);
+		return;
+	}
+
+	_jc_bc4_try(texels, hi, lo, &besterror, &r0, &r1, indices);
+	if( quality >= JC_BLOCKCOMP_QUALITY_NORMAL && besterror > 0 && innerlo <= innerhi )
+		_jc_bc4_try(texels, innerlo, innerhi, &besterror, &r0, &r1, indices);
+	if( quality >= JC_BLOCKCOMP_QUALITY_BEST && besterror > 0 )
+	{
+		// Search around the best endpoints, keeping the mode
+		int c0 = r0, c1 = r1;
+		for( int d0 = -2; d0 <= 2; ++d0 )
+		{
+			for( int d1 = -2; d1 <= 2; ++d1 )
+			{
+				if( (c0 + d0 > c1 + d1) == (c0 > c1) )
+					_jc_bc4_try(texels, c0 + d0, c1 + d1, &besterror, &r0, &r1, indices);
+			}
+		}
+	}
+	_jc_bc4_write(r0, r1, indices, out);
+}
+
+static inline void jc_bc4_decode_block(const uint8_t* block, uint8_t* texels)
+{
+	int palette[8];
+	_jc_bc4_palette(block[0], block[1], palette);
+	uint64_t bits = 0;
+	for( int i = 0; i < 6; ++i )
+		bits |= (uint64_t)block[2 + i] << (8 * i);
+	for( int i = 0; i < 16; ++i )
+		texels[i] = (uint8_t)palette[(bits >> (3 * i)) & 7];
+}
+
+// EAC R11 ****************************************************************************
+
+static const int _jc_eac_modifiers[16][8] = {
+	{ -3, -6,  -9, -15, 2, 5, 8, 14 },
+	{ -3, -7, -10, -13, 2, 6, 9, 12 },
+	{ -2, -5,  -8, -13, 1, 4, 7, 12 },
+	{ -2, -4,  -6, -13, 1, 3, 5, 12 },
+	{ -3, -6,  -8, -12, 2, 5, 7, 11 },
+	{ -3, -7,  -9, -11, 2, 6, 8, 10 },
+	{ -4, -7,  -8, -11, 3, 6, 7, 10 },
+	{ -3, -5,  -8, -11, 2, 4, 7, 10 },
+	{ -2, -6,  -8, -10, 1, 5, 7,  9 },
+	{ -2, -5,  -8, -10, 1, 4, 7,  9 },
+	{ -2, -4,  -8, -10, 1, 3, 7,  9 },
+	{ -2, -5,  -7, -10, 1, 4, 6,  9 },
+	{ -3, -4,  -7, -10, 2, 3, 6,  9 },
+	{ -1, -2,  -3, -10, 0, 1, 2,  9 },
+	{ -4, -6,  -8,  -9, 3, 5, 7,  8 },
+	{ -3, -5,  -7,  -9, 2, 4, 6,  8 },
+};
+
+// The 11 bit values of the palette
+static inline void _jc_eac_palette(int base, int multiplier, int table, int* palette)
+{
+	for( int i = 0; i < 8; ++i )
+	{
+		int modifier = _jc_eac_modifiers[table][i];
+		int v = base * 8 + 4 + (multiplier ? modifier * multiplier * 8 : modifier);
+		palette[i] = v < 0 ? 0 : (v > 2047 ? 2047 : v);
+	}
+}
+
+// The 8 bit texel from the 11 bit value
+static inline uint8_t _jc_eac_to8(int v)
+{
+	return (uint8_t)((v * 255 + 1023) / 2047);
+}
+
+// Picks the closest palette value for each (11 bit) texel. Returns the squared error, or stops when it reaches maxerror
+static inline int _jc_eac_fit(const int* texels, int base, int multiplier, int table, uint8_t* indices, int maxerror)
+{
+	int palette[8];
+	_jc_eac_palette(base, multiplier, table, palette);
+	int error = 0;
+	for( int i = 0; i < 16 && error < maxerror; ++i )
+	{
+		int best = 0;
+		int besterror = 0x7FFFFFFF;
+		for( int p = 0; p < 8; ++p )
+		{
+			int d = palette[p] - texels[i];
+			if( d * d < besterror )
+			{
+				besterror = d * d;
+				best = p;
+			}
+		}
+		indices[i] = (uint8_t)best;
+		error += besterror;
+	}
+	return error;
+}
+
+// Encodes 16 texels (row by row) into 8 bytes
+static inline void jc_eac_r11_encode_block(const uint8_t* texels, jc_blockcomp_quality quality, uint8_t* out)
+{
+	int values[16];
+	int lo = 2047, hi = 0;
+	for( int i = 0; i < 16; ++i )
+	{
+		values[i] = (texels[i] * 2047 + 127) / 255;
+		lo = values[i] < lo ? values[i] : lo;
+		hi = values[i] > hi ? values[i] : hi;
+	}
+
+	int besterror = 0x7FFFFFFF;
+	int bestbase = 0, bestmultiplier = 0, besttable = 0;
+	uint8_t bestindices[16] = {};
+	uint8_t indices[16];
+	int search = quality == JC_BLOCKCOMP_QUALITY_BEST ? 2 : (quality == JC_BLOCKCOMP_QUALITY_NORMAL ? 1 : 0);
+	for( int table = 0; table < 16 && besterror > 0; ++table )
+	{
+		// The multiplier that spans the range, and the base that centers it
+		int modlo = _jc_eac_modifiers[table][3];
+		int modhi = _jc_eac_modifiers[table][7];
+		int multiplier = ((hi - lo) + 4 * (modhi - modlo)) / (8 * (modhi - modlo));
+		multiplier = multiplier < 1 ? 1 : (multiplier > 15 ? 15 : multiplier);
+		for( int m = multiplier - search; m <= multiplier + search && besterror > 0; ++m )
+		{
+			if( m < 0 || m > 15 )
+				continue;
+			int center = ((lo + hi) - 8 - (m ? m * 8 : 1) * (modlo + modhi)) / 2;
+			int base = (center + 4) / 8;
+			for( int b = base - search; b <= base + search && besterror > 0; ++b )
+			{
+				if( b < 0 || b > 255 )
+					continue;
+				int error = _jc_eac_fit(values, b, m, table, indices, besterror);
+				if( error < besterror )
+				{
+					besterror = error;
+					bestbase = b;
+					bestmultiplier = m;
+					besttable = table;
+					memcpy(bestindices, indices, 16);
+				}
+			}
+		}
+	}
+
+	// The indices are stored column by column, big endian
+	uint64_t bits = ((uint64_t)bestbase << 56) | ((uint64_t)bestmultiplier << 52) | ((uint64_t)besttable << 48);
+	for( int x = 0; x < 4; ++x )
+	{
+		for( int y = 0; y < 4; ++y )
+			bits |= (uint64_t)bestindices[y * 4 + x] << (45 - 3 * (x * 4 + y));
+	}
+	for( int i = 0; i < 8; ++i )
+		out[i] = (uint8_t)(bits >> (56 - 8 * i));
+}
+
+static inline void jc_eac_r11_decode_block(const uint8_t* block, uint8_t* texels)
+{
+	uint64_t bits = 0;
+	for( int i = 0; i < 8; ++i )
+		bits = (bits << 8) | block[i];
+	int palette[8];
+	_jc_eac_palette((int)(bits >> 56), (int)(bits >> 52) & 15, (int)(bits >> 48) & 15, palette);
+	for( int x = 0; x < 4; ++x )
+	{
+		for( int y = 0; y < 4; ++y )
+			texels[y * 4 + x] = _jc_eac_to8(palette[(bits >> (45 - 3 * (x * 4 + y))) & 7]);
+	}
+}
+
+// Images *****************************************************************************
+
+// Encodes a single channel image into jc_blockcomp_size(width, height) bytes
+static inline void jc_blockcomp_encode(jc_blockcomp_format format, const uint8_t* image, int width, int height, jc_blockcomp_quality quality, uint8_t* out)
+{
+	uint8_t texels[16];
+	for( int by = 0; by < height; by += 4 )
+	{
+		for( int bx = 0; bx < width; bx += 4 )
+		{
+			for( int y = 0; y < 4; ++y )
+			{
+				const uint8_t* row = image + (size_t)(by + y < height ? by + y : height - 1) * width;
+				for( int x = 0; x < 4; ++x )
+					texels[y * 4 + x] = row[bx + x < width ? bx + x : width - 1];
+			}
+			if( format == JC_BLOCKCOMP_BC4 )
+				jc_bc4_encode_block(texels, quality, out);
+			else
+				jc_eac_r11_encode_block(texels, quality, out);
+			out += 8;
+		}
+	}
+}
+
+// Decodes the blocks into a single channel image
+static inline void jc_blockcomp_decode(jc_blockcomp_format format, const uint8_t* blocks, int width, int height, uint8_t* image)
+{
+	uint8_t texels[16];
+	for( int by = 0; by < height; by += 4 )
+	{
+		for( int bx = 0; bx < width; bx += 4 )
+		{
+			if( format == JC_BLOCKCOMP_BC4 )
+				jc_bc4_decode_block(blocks, texels);
+			else
+				jc_eac_r11_decode_block(blocks, texels);
+			blocks += 8;
+			for( int y = 0; y < 4 && by + y < height; ++y )
+			{
+				for( int x = 0; x < 4 && bx + x < width; ++x )
+					image[(size_t)(by + y) * width + bx + x] = texels[y * 4 + x];
+			}
+		}
+	}
+}
@@ -0,0 +1,343 @@
+#pragma once
+
+/** Reads the pair kerning from the OpenType GPOS table
+ *
+ * Only the lookups of the 'kern' feature are used: pair adjustments (PairPos format 1 and 2),
+ * also when wrapped in extension lookups. The kerning is the x advance of the first glyph.
+ *
+ * Only the pairs where both glyphs are selected (glyphmask[glyph] != 0) are reported. The class based
+ * subtables (format 2) are never expanded to all glyphs: the selected glyphs are grouped by their
+ * second class once per subtable, and only the classes with a non zero kerning are visited.
+ *
+ *	int numpairs = jc_gpos_pairs(data, fontstart, glyphmask, numglyphs, callback, userdata);
+ *
+ * The callback gets the lookup index, so that the caller can follow the OpenType rules:
+ * the first subtable of a lookup that has the pair wins, and the lookups add up.
+ * A pair record (format 1) with a zero kerning still matches, so it is reported too, with xadvance 0.
+ * A class subtable (format 2) matches every second glyph of a covered first glyph (through class 0),
+ * so the later subtables of the same lookup are skipped for that first glyph.
+ * Returns the number of pairs reported, 0 if there is no GPOS table, or -1 if it is malformed.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void (*jc_gpos_pair_fn)(void* userdata, int lookup, int glyph1, int glyph2, int xadvance);
+
+// A table, with bounds checked reads. Reading outside of it returns 0 and flags the table as invalid
+typedef struct _jc_gpos_table
+{
+	const uint8_t*	data;
+	uint32_t		size;
+	int				invalid;
+} _jc_gpos_table;
+
+static inline uint32_t _jc_gpos_u16(_jc_gpos_table* t, uint32_t offset)
+{
+	if( offset > t->size || t->size - offset < 2 )
+	{
+		t->invalid = 1;
+		return 0;
+	}
+	return ((uint32_t)t->data[offset] << 8) | t->data[offset+1];
+}
+
+static inline uint32_t _jc_gpos_u32(_jc_gpos_table* t, uint32_t offset)
+{
+	return (_jc_gpos_u16(t, offset) << 16) | _jc_gpos_u16(t, offset + 2);
+}
+
+static inline int _jc_gpos_s16(_jc_gpos_table* t, uint32_t offset)
+{
+	return (int16_t)_jc_gpos_u16(t, offset);
+}
+
+static int _jc_gpos_popcount(uint32_t v)
+{
+	int count = 0;
+	for( ; v; v &= v - 1 )
+		++count;
+	return count;
+}
+
+// Value records are a list of int16, one per bit set in the format. XAdvance is bit 2
+static int _jc_gpos_xadvance(_jc_gpos_table* t, uint32_t offset, uint32_t valueformat)
+{
+	if( !(valueformat & 4) )
+		return 0;
+	return _jc_gpos_s16(t, offset + 2 * _jc_gpos_popcount(valueformat & 3));
+}
+
+// Returns the class of the glyph (0 if it's not in the table)
+static uint32_t _jc_gpos_class(_jc_gpos_table* t, uint32_t classdef, uint32_t glyph)
+{
+	uint32_t format = _jc_gpos_u16(t, classdef);
+	if( format == 1 )
+	{
+		uint32_t start = _jc_gpos_u16(t, classdef + 2);
+		uint32_t count = _jc_gpos_u16(t, classdef + 4);
+		if( glyph >= start && glyph - start < count )
+			return _jc_gpos_u16(t, classdef + 6 + 2 * (glyph - start));
+	}
+	else if( format == 2 )
+	{
+		// The ranges are sorted
+		int first = 0;
+		int last = (int)_jc_gpos_u16(t, classdef + 2) - 1;
+		while( first <= last && !t->invalid )
+		{
+			int mid = (first + last) / 2;
+			uint32_t range = classdef + 4 + 6 * mid;
+			if( glyph < _jc_gpos_u16(t, range) )
+				last = mid - 1;
+			else if( glyph > _jc_gpos_u16(t, range + 2) )
+				first = mid + 1;
+			else
+				return _jc_gpos_u16(t, range + 4);
+		}
+	}
+	return 0;
+}
+
+typedef struct _jc_gpos_context
+{
+	_jc_gpos_table		table;
+	const uint8_t*		glyphmask;
+	int					numglyphs;
+	jc_gpos_pair_fn		callback;
+	void*				userdata;
+	int					numpairs;
+	int*				selected;		// The selected glyphs, grouped by class (format 2)
+	int*				classstart;
+	int					classcapacity;
+	int*				matchedlookup;	// The lookup where a format 2 subtable covered the (first) glyph, or -1
+} _jc_gpos_context;
+
+static int _jc_gpos_is_selected(_jc_gpos_context* ctx, uint32_t glyph)
+{
+	return glyph < (uint32_t)ctx->numglyphs && ctx->glyphmask[glyph];
+}
+
+static void _jc_gpos_pairpos1(_jc_gpos_context* ctx, int lookup, uint32_t subtable, uint32_t glyph1, uint32_t coverageindex)
+{
+	_jc_gpos_table* t = &ctx->table;
+	uint32_t valueformat1 = _jc_gpos_u16(t, subtable + 4);
+	uint32_t valueformat2 = _jc_gpos_u16(t, subtable + 6);
+	uint32_t recordsize = 2 + 2 * (_jc_gpos_popcount(valueformat1) + _jc_gpos_popcount(valueformat2));
+	uint32_t pairset = subtable + _jc_gpos_u16(t, subtable + 10 + 2 * coverageindex);
+	uint32_t count = _jc_gpos_u16(t, pairset);
+	for( uint32_t i = 0; i < count && !t->invalid; ++i )
+	{
+		uint32_t record = pairset + 2 + i * recordsize;
+		uint32_t glyph2 = _jc_gpos_u16(t, record);
+		int xadvance = _jc_gpos_xadvance(t, record + 2, valueformat1);
+		if( _jc_gpos_is_selected(ctx, glyph2) )
+		{
+			ctx->callback(ctx->userdata, lookup, (int)glyph1, (int)glyph2, xadvance);
+			ctx->numpairs++;
+		}
+	}
+}
+
+// Groups the selected glyphs by their class in classdef2. Returns 0 on failure
+static int _jc_gpos_group_classes(_jc_gpos_context* ctx, uint32_t classdef2, uint32_t class2count)
+{
+	_jc_gpos_table* t = &ctx->table;
+	if( (int)class2count + 1 > ctx->classcapacity )
+	{
+		free(ctx->classstart);
+		ctx->classcapacity = (int)class2count + 1;
+		ctx->classstart = (int*)malloc(sizeof(int) * ctx->classcapacity);
+	}
+	int* classstart = ctx->classstart;
+	memset(classstart, 0, sizeof(int) * (class2count + 1));
+
+	// Counting sort, by class
+	for( int g = 0; g < ctx->numglyphs; ++g )
+	{
+		if( !ctx->glyphmask[g] )
+			continue;
+		uint32_t c = _jc_gpos_class(t, classdef2, (uint32_t)g);
+		if( c < class2count )
+			classstart[c + 1]++;
+	}
+	for( uint32_t c = 0; c < class2count; ++c )
+		classstart[c + 1] += classstart[c];
+	int* next = (int*)malloc(sizeof(int) * (class2count + 1));
+	memcpy(next, classstart, sizeof(int) * (class2count + 1));
+	for( int g = 0; g < ctx->numglyphs; ++g )
+	{
+		if( !ctx->glyphmask[g] )
+			continue;
+		uint32_t c = _jc_gpos_class(t, classdef2, (uint32_t)g);
+		if( c < class2count )
+			ctx->selected[next[c]++] = g;
+	}
+	free(next);
+	return !t->invalid;
+}
+
+static void _jc_gpos_pairpos2(_jc_gpos_context* ctx, int lookup, uint32_t subtable, uint32_t glyph1)
+{
+	_jc_gpos_table* t = &ctx->table;
+	uint32_t valueformat1 = _jc_gpos_u16(t, subtable + 4);
+	uint32_t valueformat2 = _jc_gpos_u16(t, subtable + 6);
+	uint32_t classdef1 = subtable + _jc_gpos_u16(t, subtable + 8);
+	uint32_t class2count = _jc_gpos_u16(t, subtable + 14);
+	uint32_t recordsize = 2 * (_jc_gpos_popcount(valueformat1) + _jc_gpos_popcount(valueformat2));
+
+	uint32_t class1 = _jc_gpos_class(t, classdef1, glyph1);
+	if( class1 >= _jc_gpos_u16(t, subtable + 12) )
+		return;
+	ctx->matchedlookup[glyph1] = lookup;
+	uint32_t row = subtable + 16 + class1 * class2count * recordsize;
+	for( uint32_t c = 0; c < class2count && !t->invalid; ++c )
+	{
+		int xadvance = _jc_gpos_xadvance(t, row + c * recordsize, valueformat1);
+		if( !xadvance )
+			continue;
+		for( int i = ctx->classstart[c]; i < ctx->classstart[c + 1]; ++i )
+		{
+			ctx->callback(ctx->userdata, lookup, (int)glyph1, ctx->selected[i], xadvance);
+			ctx->numpairs++;
+		}
+	}
+}
+
+static void _jc_gpos_subtable(_jc_gpos_context* ctx, int lookup, uint32_t subtable)
+{
+	_jc_gpos_table* t = &ctx->table;
+	uint32_t format = _jc_gpos_u16(t, subtable);
+	if( format != 1 && format != 2 )
+		return;
+	if( format == 2 && !_jc_gpos_group_classes(ctx, subtable + _jc_gpos_u16(t, subtable + 10), _jc_gpos_u16(t, subtable + 14)) )
+		return;
+
+	// Visit the glyphs in the coverage table, with their coverage index
+	uint32_t coverage = subtable + _jc_gpos_u16(t, subtable + 2);
+	uint32_t coverageformat = _jc_gpos_u16(t, coverage);
+	uint32_t count = _jc_gpos_u16(t, coverage + 2);
+	for( uint32_t i = 0; i < count && !t->invalid; ++i )
+	{
+		uint32_t first, last, index;
+		if( coverageformat == 1 )
+		{
+			first = last = _jc_gpos_u16(t, coverage + 4 + 2 * i);
+			index = i;
+		}
+		else if( coverageformat == 2 )
+		{
+			first = _jc_gpos_u16(t, coverage + 4 + 6 * i);
+			last = _jc_gpos_u16(t, coverage + 4 + 6 * i + 2);
+			index = _jc_gpos_u16(t, coverage + 4 + 6 * i + 4);
+		}
+		else
+			return;
+
+		for( uint32_t glyph1 = first; glyph1 <= last && !t->invalid; ++glyph1, ++index )
+		{
+			if( !_jc_gpos_is_selected(ctx, glyph1) || ctx->matchedlookup[glyph1] == lookup )
+				continue;
+			if( format == 1 )
+				_jc_gpos_pairpos1(ctx, lookup, subtable, glyph1, index);
+			else
+				_jc_gpos_pairpos2(ctx, lookup, subtable, glyph1);
+		}
+	}
+}
+
+// Finds a table in the font directory. Returns 0 if it's not there
+static uint32_t _jc_gpos_find_table(const uint8_t* data, int fontstart, const char* tag, uint32_t* size)
+{
+	const uint8_t* dir = data + fontstart;
+	uint32_t numtables = ((uint32_t)dir[4] << 8) | dir[5];
+	for( uint32_t i = 0; i < numtables; ++i )
+	{
+		const uint8_t* entry = dir + 12 + 16 * i;
+		if( memcmp(entry, tag, 4) == 0 )
+		{
+			*size = ((uint32_t)entry[12] << 24) | ((uint32_t)entry[13] << 16) | ((uint32_t)entry[14] << 8) | entry[15];
+			return ((uint32_t)entry[8] << 24) | ((uint32_t)entry[9] << 16) | ((uint32_t)entry[10] << 8) | entry[11];
+		}
+	}
+	return 0;
+}
+
+int jc_gpos_pairs(const uint8_t* data, int fontstart, const uint8_t* glyphmask, int numglyphs, jc_gpos_pair_fn callback, void* userdata)
+{
+	uint32_t size = 0;
+	uint32_t offset = _jc_gpos_find_table(data, fontstart, "GPOS", &size);
+	if( !offset )
+		return 0;
+
+	_jc_gpos_context ctx;
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.table.data	= data + offset;
+	ctx.table.size	= size;
+	ctx.glyphmask	= glyphmask;
+	ctx.numglyphs	= numglyphs;
+	ctx.callback	= callback;
+	ctx.userdata	= userdata;
+	ctx.selected	= (int*)malloc(sizeof(int) * (numglyphs > 0 ? numglyphs : 1));
+	ctx.matchedlookup = (int*)malloc(sizeof(int) * (numglyphs > 0 ? numglyphs : 1));
+	for( int g = 0; g < numglyphs; ++g )
+		ctx.matchedlookup[g] = -1;
+
+	_jc_gpos_table* t = &ctx.table;
+	uint32_t featurelist = _jc_gpos_u16(t, 6);
+	uint32_t lookuplist = _jc_gpos_u16(t, 8);
+	uint32_t numlookups = _jc_gpos_u16(t, lookuplist);
+
+	// The lookups used by any 'kern' feature (of any script/language)
+	uint8_t* used = (uint8_t*)calloc(numlookups ? numlookups : 1, 1);
+	uint32_t numfeatures = _jc_gpos_u16(t, featurelist);
+	for( uint32_t f = 0; f < numfeatures && !t->invalid; ++f )
+	{
+		uint32_t record = featurelist + 2 + 6 * f;
+		if( record + 6 > t->size )
+		{
+			t->invalid = 1;
+			break;
+		}
+		if( memcmp(t->data + record, "kern", 4) != 0 )
+			continue;
+		uint32_t feature = featurelist + _jc_gpos_u16(t, record + 4);
+		uint32_t count = _jc_gpos_u16(t, feature + 2);
+		for( uint32_t i = 0; i < count; ++i )
+		{
+			uint32_t l = _jc_gpos_u16(t, feature + 4 + 2 * i);
+			if( l < numlookups )
+				used[l] = 1;
+		}
+	}
+
+	for( uint32_t l = 0; l < numlookups && !t->invalid; ++l )
+	{
+		if( !used[l] )
+			continue;
+		uint32_t lookup = lookuplist + _jc_gpos_u16(t, lookuplist + 2 + 2 * l);
+		uint32_t type = _jc_gpos_u16(t, lookup);
+		uint32_t numsubtables = _jc_gpos_u16(t, lookup + 4);
+		for( uint32_t s = 0; s < numsubtables && !t->invalid; ++s )
+		{
+			uint32_t subtable = lookup + _jc_gpos_u16(t, lookup + 6 + 2 * s);
+			if( type == 9 )		// Extension: the real type, and a 32 bit offset
+			{
+				if( _jc_gpos_u16(t, subtable + 2) != 2 )
+					continue;
+				subtable += _jc_gpos_u32(t, subtable + 4);
+			}
+			else if( type != 2 )
+				break;
+			_jc_gpos_subtable(&ctx, (int)l, subtable);
+		}
+	}
+
+	int invalid = t->invalid;
+	free(used);
+	free(ctx.selected);
+	free(ctx.classstart);
+	free(ctx.matchedlookup);
+	return invalid ? -1 : ctx.numpairs;
+}
@@ -0,0 +1,189 @@
+#pragma once
+
+/** LZ4 block compression (the raw block format, without the frame)
+ *
+ * A greedy single probe compressor, which does well on distance fields (long runs of 0 and 255),
+ * and a decompressor that checks all reads and writes, so it is safe to use on untrusted data.
+ *
+ *	size_t capacity = jc_lz4_compress_bound(size);
+ *	size_t compressedsize = jc_lz4_compress(data, size, compressed, capacity);
+ *	int ok = jc_lz4_decompress(compressed, compressedsize, out, size) == size;
+ *
+ * The functions are static, since this is also included by the runtime reader (font_reader.h)
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define _JC_LZ4_MINMATCH		4
+#define _JC_LZ4_LASTLITERALS	5		// The last bytes are always literals
+#define _JC_LZ4_MFLIMIT			12		// The last match starts at least this far from the end
+#define _JC_LZ4_MAXOFFSET		65535
+#define _JC_LZ4_HASHBITS		14
+
+static inline size_t jc_lz4_compress_bound(size_t size)
+{
+	return size + size / 255 + 16;
+}
+
+static inline uint32_t _jc_lz4_read32(const uint8_t* p)
+{
+	uint32_t v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+
+static inline uint32_t _jc_lz4_hash(uint32_t v)
+{
+	return (v * 2654435761u) >> (32 - _JC_LZ4_HASHBITS);
+}
+
+// Writes the extra length bytes, when the length doesn't fit in the token. Returns 0 if it doesn't fit in dst
+static inline int _jc_lz4_write_length(uint8_t** op, const uint8_t* end, size_t length)
+{
+	if( length < 15 )
+		return 1;
+	for( length -= 15; length >= 255; length -= 255 )
+	{
+		if( *op >= end )
+			return 0;
+		*(*op)++ = 255;
+	}
+	if( *op >= end )
+		return 0;
+	*(*op)++ = (uint8_t)length;
+	return 1;
+}
+
+// Writes the literals, and the match (if matchlength != 0). Returns 0 if it doesn't fit in dst
+static inline int _jc_lz4_write_sequence(uint8_t** op, const uint8_t* end, const uint8_t* literals, size_t numliterals, size_t offset, size_t matchlength)
+{
+	if( *op >= end )
+		return 0;
+	uint8_t* token = (*op)++;
+	size_t matchcode = matchlength ? matchlength - _JC_LZ4_MINMATCH : 0;
+	*token = (uint8_t)(((numliterals < 15 ? numliterals : 15) << 4) | (matchcode < 15 ? matchcode : 15));
+	if( !_jc_lz4_write_length(op, end, numliterals) || (size_t)(end - *op) < numliterals )
+		return 0;
+	if( numliterals )
+		memcpy(*op, literals, numliterals);
+	*op += numliterals;
+	if( !matchlength )
+		return 1;
+	if( end - *op < 2 )
+		return 0;
+	*(*op)++ = (uint8_t)(offset & 0xFF);
+	*(*op)++ = (uint8_t)(offset >> 8);
+	return _jc_lz4_write_length(op, end, matchcode);
+}
+
+/** Returns the compressed size, or 0 if it doesn't fit in dstcapacity (jc_lz4_compress_bound() always fits)
+ */
+static inline size_t jc_lz4_compress(const uint8_t* src, size_t srcsize, uint8_t* dst, size_t dstcapacity)
+{
+	uint8_t* op = dst;
+	const uint8_t* end = dst + dstcapacity;
+	size_t anchor = 0;
+
+	if( srcsize > _JC_LZ4_MFLIMIT )
+	{
+		// The last position a match can be found at, and where they have to end
+		size_t lastmatch = srcsize - _JC_LZ4_MFLIMIT;
+		size_t matchlimit = srcsize - _JC_LZ4_LASTLITERALS;
+
+		uint32_t table[1 << _JC_LZ4_HASHBITS];
+		memset(table, 0, sizeof(table));
+
+		size_t ip = 0;
+		while( ip <= lastmatch )
+		{
+			uint32_t sequence = _jc_lz4_read32(src + ip);
+			uint32_t h = _jc_lz4_hash(sequence);
+			size_t candidate = table[h];
+			table[h] = (uint32_t)ip;
+			if( candidate >= ip || ip - candidate > _JC_LZ4_MAXOFFSET || _jc_lz4_read32(src + candidate) != sequence )
+			{
+				++ip;
+				continue;
+			}
+
+			size_t length = _JC_LZ4_MINMATCH;
+			while( ip + length < matchlimit && src[candidate + length] == src[ip + length] )
+				++length;
+
+			if( !_jc_lz4_write_sequence(&op, end, src + anchor, ip - anchor, ip - candidate, length) )
+				return 0;
+			ip += length;
+			anchor = ip;
+		}
+	}
+
+	if( !_jc_lz4_write_sequence(&op, end, src + anchor, srcsize - anchor, 0, 0) )
+		return 0;
+	return (size_t)(op - dst);
+}
+
+// Reads the extra length bytes. Returns 0 if the data ends
+static inline int _jc_lz4_read_length(const uint8_t** ip, const uint8_t* end, size_t* length)
+{
+	if( *length != 15 )
+		return 1;
+	uint8_t b;
+	do
+	{
+		if( *ip >= end )
+			return 0;
+		b = *(*ip)++;
+		*length += b;
+	} while( b == 255 );
+	return 1;
+}
+
+/** Returns the decompressed size, or (size_t)-1 if the data is malformed, or doesn't fit in dstsize
+ */
+static inline size_t jc_lz4_decompress(const uint8_t* src, size_t srcsize, uint8_t* dst, size_t dstsize)
+{
+	const uint8_t* ip = src;
+	const uint8_t* end = src + srcsize;
+	size_t op = 0;
+	while( ip < end )
+	{
+		uint8_t token = *ip++;
+		size_t numliterals = token >> 4;
+		if( !_jc_lz4_read_length(&ip, end, &numliterals) || numliterals > (size_t)(end - ip) || numliterals > dstsize - op )
+			return (size_t)-1;
+		if( numliterals )
+			memcpy(dst + op, ip, numliterals);
+		ip += numliterals;
+		op += numliterals;
+
+		// The last sequence has no match
+		if( ip == end )
+			break;
+
+		if( end - ip < 2 )
+			return (size_t)-1;
+		size_t offset = ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		size_t length = token & 15;
+		if( offset == 0 || offset > op || !_jc_lz4_read_length(&ip, end, &length) )
+			return (size_t)-1;
+		length += _JC_LZ4_MINMATCH;
+		if( length > dstsize - op )
+			return (size_t)-1;
+
+		// The match may overlap what it writes (e.g. runs), so it's copied forwards
+		const uint8_t* match = dst + op - offset;
+		uint8_t* out = dst + op;
+		if( offset >= length )
+			memcpy(out, match, length);
+		else
+		{
+			for( size_t i = 0; i < length; ++i )
+				out[i] = match[i];
+		}
+		op += length;
+	}
+	return op;
+}
@@ -0,0 +1,510 @@
+#pragma once
+
+/** A fast PNG encoder for 8 and 16 bit images (1-4 channels), that encodes the image in strips that can run in parallel
+ *
+ *	jc_png_strip strips[4];
+ *	for( int i = 0; i < 4; ++i )	// e.g. on one thread each
+ *		jc_png_encode_strip(pixels, width, height, channels, 8, 0, height * i / 4, height * (i + 1) / 4, level, JC_PNG_FILTER_ADAPTIVE, &strips[i]);
+ *	jc_png_write(path, width, height, channels, 8, strips, 4);
+ *	for( int i = 0; i < 4; ++i )
+ *		jc_png_free_strip(&strips[i]);
+ *
+ * Each strip is filtered, deflated (without references to other strips), and checksummed on its own,
+ * and ends up in its own IDAT chunk. The Adler-32 of the whole image is combined from the strips.
+ *
+ * Level 0 stores the data uncompressed (fast, for intermediate builds). Levels 1-9 use LZ77 with a hash chain of
+ * increasing length, and the fixed Huffman codes.
+ * The adaptive filter picks one filter per row, using the smallest sum of absolute differences (as libpng).
+ * The 16 bit samples are read as little endian, and written as big endian (as PNG requires).
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef enum _jc_png_filter
+{
+	JC_PNG_FILTER_NONE,
+	JC_PNG_FILTER_SUB,
+	JC_PNG_FILTER_UP,
+	JC_PNG_FILTER_AVERAGE,
+	JC_PNG_FILTER_PAETH,
+	JC_PNG_FILTER_ADAPTIVE,	// One of the above, per row
+} jc_png_filter;
+
+typedef struct _jc_png_strip
+{
+	uint8_t*	data;		// Part of the zlib stream. The first strip has the zlib header
+	size_t		size;
+	size_t		rawsize;	// The size of the filtered rows
+	uint32_t	adler;		// Adler-32 of the filtered rows
+	uint32_t	crc;		// CRC of the IDAT chunk
+} jc_png_strip;
+
+static const uint32_t _jc_png_crc_table[256] = {
+	0x00000000, 0x77073096, 0xEE0E612C, 0x990951BA, 0x076DC419, 0x706AF48F, 0xE963A535, 0x9E6495A3,
+	0x0EDB8832, 0x79DCB8A4, 0xE0D5E91E, 0x97D2D988, 0x09B64C2B, 0x7EB17CBD, 0xE7B82D07, 0x90BF1D91,
+	0x1DB71064, 0x6AB020F2, 0xF3B97148, 0x84BE41DE, 0x1ADAD47D, 0x6DDDE4EB, 0xF4D4B551, 0x83D385C7,
+	0x136C9856, 0x646BA8C0, 0xFD62F97A, 0x8A65C9EC, 0x14015C4F, 0x63066CD9, 0xFA0F3D63, 0x8D080DF5,
+	0x3B6E20C8, 0x4C69105E, 0xD56041E4, 0xA2677172, 0x3C03E4D1, 0x4B04D447, 0xD20D85FD, 0xA50AB56B,
+	0x35B5A8FA, 0x42B2986C, 0xDBBBC9D6, 0xACBCF940, 0x32D86CE3, 0x45DF5C75, 0xDCD60DCF, 0xABD13D59,
+	0x26D930AC, 0x51DE003A, 0xC8D75180, 0xBFD06116, 0x21B4F4B5, 0x56B3C423, 0xCFBA9599, 0xB8BDA50F,
+	0x2802B89E, 0x5F058808, 0xC60CD9B2, 0xB10BE924, 0x2F6F7C87, 0x58684C11, 0xC1611DAB, 0xB6662D3D,
+	0x76DC4190, 0x01DB7106, 0x98D220BC, 0xEFD5102A, 0x71B18589, 0x06B6B51F, 0x9FBFE4A5, 0xE8B8D433,
+	0x7807C9A2, 0x0F00F934, 0x9609A88E, 0xE10E9818, 0x7F6A0DBB, 0x086D3D2D, 0x91646C97, 0xE6635C01,
+	0x6B6B51F4, 0x1C6C6162, 0x856530D8, 0xF262004E, 0x6C0695ED, 0x1B01A57B, 0x8208F4C1, 0xF50FC457,
+	0x65B0D9C6, 0x12B7E950, 0x8BBEB8EA, 0xFCB9887C, 0x62DD1DDF, 0x15DA2D49, 0x8CD37CF3, 0xFBD44C65,
+	0x4DB26158, 0x3AB551CE, 0xA3BC0074, 0xD4BB30E2, 0x4ADFA541, 0x3DD895D7, 0xA4D1C46D, 0xD3D6F4FB,
+	0x4369E96A, 0x346ED9FC, 0xAD678846, 0xDA60B8D0, 0x44042D73, 0x33031DE5, 0xAA0A4C5F, 0xDD0D7CC9,
+	0x5005713C, 0x270241AA, 0xBE0B1010, 0xC90C2086, 0x5768B525, 0x206F85B3, 0xB966D409, 0xCE61E49F,
+	0x5EDEF90E, 0x29D9C998, 0xB0D09822, 0xC7D7A8B4, 0x59B33D17, 0x2EB40D81, 0xB7BD5C3B, 0xC0BA6CAD,
+	0xEDB88320, 0x9ABFB3B6, 0x03B6E20C, 0x74B1D29A, 0xEAD54739, 0x9DD277AF, 0x04DB2615, 0x73DC1683,
+	0xE3630B12, 0x94643B84, 0x0D6D6A3E, 0x7A6A5AA8, 0xE40ECF0B, 0x9309FF9D, 0x0A00AE27, 0x7D079EB1,
+	0xF00F9344, 0x8708A3D2, 0x1E01F268, 0x6906C2FE, 0xF762575D, 0x806567CB, 0x196C3671, 0x6E6B06E7,
+	0xFED41B76, 0x89D32BE0, 0x10DA7A5A, 0x67DD4ACC, 0xF9B9DF6F, 0x8EBEEFF9, 0x17B7BE43, 0x60B08ED5,
+	0xD6D6A3E8, 0xA1D1937E, 0x38D8C2C4, 0x4FDFF252, 0xD1BB67F1, 0xA6BC5767, 0x3FB506DD, 0x48B2364B,
+	0xD80D2BDA, 0xAF0A1B4C, 0x36034AF6, 0x41047A60, 0xDF60EFC3, 0xA867DF55, 0x316E8EEF, 0x4669BE79,
+	0xCB61B38C, 0xBC66831A, 0x256FD2A0, 0x5268E236, 0xCC0C7795, 0xBB0B4703, 0x220216B9, 0x5505262F,
+	0xC5BA3BBE, 0xB2BD0B28, 0x2BB45A92, 0x5CB36A04, 0xC2D7FFA7, 0xB5D0CF31, 0x2CD99E8B, 0x5BDEAE1D,
+	0x9B64C2B0, 0xEC63F226, 0x756AA39C, 0x026D930A, 0x9C0906A9, 0xEB0E363F, 0x72076785, 0x05005713,
+	0x95BF4A82, 0xE2B87A14, 0x7BB12BAE, 0x0CB61B38, 0x92D28E9B, 0xE5D5BE0D, 0x7CDCEFB7, 0x0BDBDF21,
+	0x86D3D2D4, 0xF1D4E242, 0x68DDB3F8, 0x1FDA836E, 0x81BE16CD, 0xF6B9265B, 0x6FB077E1, 0x18B74777,
+	0x88085AE6, 0xFF0F6A70, 0x66063BCA, 0x11010B5C, 0x8F659EFF, 0xF862AE69, 0x616BFFD3, 0x166CCF45,
+	0xA00AE278, 0xD70DD2EE, 0x4E048354, 0x3903B3C2, 0xA7672661, 0xD06016F7, 0x4969474D, 0x3E6E77DB,
+	0xAED16A4A, 0xD9D65ADC, 0x40DF0B66, 0x37D83BF0, 0xA9BCAE53, 0xDEBB9EC5, 0x47B2CF7F, 0x30B5FFE9,
+	0xBDBDF21C, 0xCABAC28A, 0x53B39330, 0x24B4A3A6, 0xBAD03605, 0xCDD70693, 0x54DE5729, 0x23D967BF,
+	0xB3667A2E, 0xC4614AB8, 0x5D681B02, 0x2A6F2B94, 0xB40BBE37, 0xC30C8EA1, 0x5A05DF1B, 0x2D02EF8D,
+};
+
+static uint32_t _jc_png_crc(uint32_t crc, const uint8_t* data, size_t size)
+{
+	crc = ~crc;
+	for( size_t i = 0; i < size; ++i )
+		crc = _jc_png_crc_table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+	return ~crc;
+}
+
+#define _JC_PNG_ADLER_BASE	65521
+#define _JC_PNG_ADLER_NMAX	5552	// The most bytes before the sums can overflow
+
+static uint32_t _jc_png_adler(uint32_t adler, const uint8_t* data, size_t size)
+{
+	uint32_t a = adler & 0xFFFF;
+	uint32_t b = adler >> 16;
+	while( size )
+	{
+		size_t n = size < _JC_PNG_ADLER_NMAX ? size : _JC_PNG_ADLER_NMAX;
+		size -= n;
+		for( size_t i = 0; i < n; ++i )
+		{
+			a += data[i];
+			b += a;
+		}
+		data += n;
+		a %= _JC_PNG_ADLER_BASE;
+		b %= _JC_PNG_ADLER_BASE;
+	}
+	return (b << 16) | a;
+}
+
+// The Adler-32 of two buffers after each other, from their Adler-32s (same as zlib's adler32_combine)
+static uint32_t _jc_png_adler_combine(uint32_t adler1, uint32_t adler2, size_t size2)
+{
+	uint64_t rem = size2 % _JC_PNG_ADLER_BASE;
+	uint64_t a1 = adler1 & 0xFFFF;
+	uint64_t a = a1 + (adler2 & 0xFFFF) + _JC_PNG_ADLER_BASE - 1;
+	uint64_t b = (rem * a1) % _JC_PNG_ADLER_BASE + (adler1 >> 16) + (adler2 >> 16) + _JC_PNG_ADLER_BASE - rem;
+	a %= _JC_PNG_ADLER_BASE;
+	b %= _JC_PNG_ADLER_BASE;
+	return (uint32_t)((b << 16) | a);
+}
+
+static inline int _jc_png_paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if( pa <= pb && pa <= pc )
+		return a;
+	return pb <= pc ? b : c;
+}
+
+// Filters the row. prev is the previous row (all zeros for the first row)
+static void _jc_png_filter_row(int filter, const uint8_t* row, const uint8_t* prev, int rowsize, int bpp, uint8_t* out)
+{
+	int x = 0;
+	switch( filter )
+	{
+	case JC_PNG_FILTER_SUB:
+		for( ; x < bpp; ++x )
+			out[x] = row[x];
+		for( ; x < rowsize; ++x )
+			out[x] = (uint8_t)(row[x] - row[x - bpp]);
+		break;
+	case JC_PNG_FILTER_UP:
+		for( ; x < rowsize; ++x )
+			out[x] = (uint8_t)(row[x] - prev[x]);
+		break;
+	case JC_PNG_FILTER_AVERAGE:
+		for( ; x < bpp; ++x )
+			out[x] = (uint8_t)(row[x] - (prev[x] >> 1));
+		for( ; x < rowsize; ++x )
+			out[x] = (uint8_t)(row[x] - ((row[x - bpp] + prev[x]) >> 1));
+		break;
+	case JC_PNG_FILTER_PAETH:
+		for( ; x < bpp; ++x )
+			out[x] = (uint8_t)(row[x] - prev[x]);
+		for( ; x < rowsize; ++x )
+			out[x] = (uint8_t)(row[x] - _jc_png_paeth(row[x - bpp], prev[x], prev[x - bpp]));
+		break;
+	default:
+		memcpy(out, row, (size_t)rowsize);
+		break;
+	}
+}
+
+// Picks the filter with the smallest sum of the (signed) filtered bytes, in one pass over the row
+static int _jc_png_choose_filter(const uint8_t* row, const uint8_t* prev, int rowsize, int bpp)
+{
+	uint32_t sums[5] = { 0, 0, 0, 0, 0 };
+	for( int x = 0; x < rowsize; ++x )
+	{
+		int a = x >= bpp ? row[x - bpp] : 0;
+		int b = prev[x];
+		int c = x >= bpp ? prev[x - bpp] : 0;
+		int v = row[x];
+		sums[0] += (uint32_t)abs((int8_t)v);
+		sums[1] += (uint32_t)abs((int8_t)(v - a));
+		sums[2] += (uint32_t)abs((int8_t)(v - b));
+		sums[3] += (uint32_t)abs((int8_t)(v - ((a + b) >> 1)));
+		sums[4] += (uint32_t)abs((int8_t)(v - _jc_png_paeth(a, b, c)));
+	}
+	int best = 0;
+	for( int f = 1; f < 5; ++f )
+		best = sums[f] < sums[best] ? f : best;
+	return best;
+}
+
+// Deflate ****************************************************************************
+
+typedef struct _jc_png_bitwriter
+{
+	uint8_t*	data;
+	size_t		size;
+	uint64_t	bits;
+	int			numbits;
+} _jc_png_bitwriter;
+
+static inline void _jc_png_put_bits(_jc_png_bitwriter* w, uint32_t value, int numbits)
+{
+	w->bits |= (uint64_t)value << w->numbits;
+	w->numbits += numbits;
+	while( w->numbits >= 8 )
+	{
+		w->data[w->size++] = (uint8_t)w->bits;
+		w->bits >>= 8;
+		w->numbits -= 8;
+	}
+}
+
+static inline void _jc_png_align(_jc_png_bitwriter* w)
+{
+	if( w->numbits )
+		_jc_png_put_bits(w, 0, 8 - w->numbits);
+}
+
+static inline uint32_t _jc_png_reverse(uint32_t code, int numbits)
+{
+	uint32_t r = 0;
+	for( int i = 0; i < numbits; ++i, code >>= 1 )
+		r = (r << 1) | (code & 1);
+	return r;
+}
+
+// The fixed Huffman code of a literal/length symbol, bit reversed for writing
+static inline void _jc_png_put_symbol(_jc_png_bitwriter* w, int symbol)
+{
+	if( symbol < 144 )
+		_jc_png_put_bits(w, _jc_png_reverse(0x30 + symbol, 8), 8);
+	else if( symbol < 256 )
+		_jc_png_put_bits(w, _jc_png_reverse(0x190 + symbol - 144, 9), 9);
+	else if( symbol < 280 )
+		_jc_png_put_bits(w, _jc_png_reverse(symbol - 256, 7), 7);
+	else
+		_jc_png_put_bits(w, _jc_png_reverse(0xC0 + symbol - 280, 8), 8);
+}
+
+static const uint16_t _jc_png_length_base[29] = { 3,4,5,6,7,8,9,10,11,13,15,17,19,23,27,31,35,43,51,59,67,83,99,115,131,163,195,227,258 };
+static const uint8_t _jc_png_length_extra[29] = { 0,0,0,0,0,0,0,0,1,1,1,1,2,2,2,2,3,3,3,3,4,4,4,4,5,5,5,5,0 };
+
+static void _jc_png_put_match(_jc_png_bitwriter* w, int length, int distance)
+{
+	int code = 28;
+	while( _jc_png_length_base[code] > length )
+		--code;
+	_jc_png_put_symbol(w, 257 + code);
+	_jc_png_put_bits(w, (uint32_t)(length - _jc_png_length_base[code]), _jc_png_length_extra[code]);
+
+	// Distance codes come in pairs, with one more extra bit every pair
+	uint32_t d = (uint32_t)distance - 1;
+	int dcode = (int)d;
+	int extra = 0;
+	if( d >= 4 )
+	{
+		int highbit = 2;
+		while( (d >> (highbit + 1)) != 0 )
+			++highbit;
+		extra = highbit - 1;
+		dcode = 2 * highbit + (int)((d >> extra) & 1);
+	}
+	_jc_png_put_bits(w, _jc_png_reverse((uint32_t)dcode, 5), 5);
+	_jc_png_put_bits(w, d & ((1u << extra) - 1), extra);
+}
+
+#define _JC_PNG_WINDOW		32768
+#define _JC_PNG_HASHBITS	15
+#define _JC_PNG_MAXMATCH	258
+
+static inline uint32_t _jc_png_hash(const uint8_t* p)
+{
+	return ((((uint32_t)p[0] << 16) | ((uint32_t)p[1] << 8) | p[2]) * 2654435761u) >> (32 - _JC_PNG_HASHBITS);
+}
+
+// Compresses the data as one fixed Huffman block
+static void _jc_png_deflate(_jc_png_bitwriter* w, const uint8_t* data, size_t size, int level, int final)
+{
+	static const int chainlengths[10] = { 0, 1, 2, 4, 8, 16, 32, 64, 128, 256 };
+	int maxchain = chainlengths[level];
+	int nicelength = level < 4 ? 32 : _JC_PNG_MAXMATCH;
+
+	int32_t* head = (int32_t*)malloc(sizeof(int32_t) * (1 << _JC_PNG_HASHBITS));
+	int32_t* prev = (int32_t*)malloc(sizeof(int32_t) * _JC_PNG_WINDOW);
+	for( int i = 0; i < (1 << _JC_PNG_HASHBITS); ++i )
+		head[i] = -1;
+
+	_jc_png_put_bits(w, final ? 1 : 0, 1);
+	_jc_png_put_bits(w, 1, 2);	// Fixed Huffman codes
+
+	size_t i = 0;
+	while( i < size )
+	{
+		int bestlength = 0;
+		size_t bestdistance = 0;
+		if( i + 3 <= size )
+		{
+			uint32_t h = _jc_png_hash(data + i);
+			int32_t candidate = head[h];
+			prev[i & (_JC_PNG_WINDOW - 1)] = candidate;
+			head[h] = (int32_t)i;
+
+			size_t maxlength = size - i < _JC_PNG_MAXMATCH ? size - i : _JC_PNG_MAXMATCH;
+			for( int chain = 0; chain < maxchain && candidate >= 0 && i - (size_t)candidate <= _JC_PNG_WINDOW; ++chain )
+			{
+				const uint8_t* a = data + candidate;
+				const uint8_t* b = data + i;
+				if( a[bestlength] == b[bestlength] )
+				{
+					size_t length = 0;
+					while( length < maxlength && a[length] == b[length] )
+						++length;
+					if( (int)length > bestlength )
+					{
+						bestlength = (int)length;
+						bestdistance = i - (size_t)candidate;
+						if( bestlength >= nicelength || length == maxlength )
+							break;
+					}
+				}
+				int32_t next = prev[candidate & (_JC_PNG_WINDOW - 1)];
+				if( next >= candidate )	// Overwritten by a newer position
+					break;
+				candidate = next;
+			}
+		}
+
+		if( bestlength < 3 )
+		{
+			_jc_png_put_symbol(w, data[i]);
+			++i;
+			continue;
+		}
+
+		_jc_png_put_match(w, bestlength, (int)bestdistance);
+		// The higher levels also find matches starting inside this one
+		size_t end = i + (size_t)bestlength;
+		for( ++i; i < end; ++i )
+		{
+			if( level >= 4 && i + 3 <= size )
+			{
+				uint32_t h = _jc_png_hash(data + i);
+				prev[i & (_JC_PNG_WINDOW - 1)] = head[h];
+				head[h] = (int32_t)i;
+			}
+		}
+	}
+	_jc_png_put_symbol(w, 256);
+
+	free(head);
+	free(prev);
+}
+
+// Stored blocks, up to 65535 bytes each
+static void _jc_png_store(_jc_png_bitwriter* w, const uint8_t* data, size_t size, int final)
+{
+	do
+	{
+		size_t n = size < 65535 ? size : 65535;
+		size -= n;
+		_jc_png_put_bits(w, final && size == 0 ? 1 : 0, 1);
+		_jc_png_put_bits(w, 0, 2);
+		_jc_png_align(w);
+		_jc_png_put_bits(w, (uint32_t)n, 16);
+		_jc_png_put_bits(w, (uint32_t)n ^ 0xFFFF, 16);
+		if( n )
+			memcpy(w->data + w->size, data, n);
+		w->size += n;
+		data += n;
+	} while( size );
+}
+
+// Encoding ***************************************************************************
+
+static void _jc_png_swap16(const uint8_t* row, int rowsize, uint8_t* out)
+{
+	for( int x = 0; x < rowsize; x += 2 )
+	{
+		out[x]		= row[x + 1];
+		out[x + 1]	= row[x];
+	}
+}
+
+/** Filters and compresses the rows [y0, y1) of the image. The strips have to cover all rows, in order, with at least one row each.
+ * bitdepth is 8 or 16 (bits per channel), and stride is the number of bytes per row (0 means width * channels * bitdepth / 8)
+ */
+static void jc_png_encode_strip(const uint8_t* pixels, int width, int height, int channels, int bitdepth, int stride, int y0, int y1,
+								int level, jc_png_filter filter, jc_png_strip* strip)
+{
+	int bpp = channels * (bitdepth / 8);
+	int rowsize = width * bpp;
+	stride = stride ? stride : rowsize;
+	level = level < 0 ? 0 : (level > 9 ? 9 : level);
+
+	// The filtered rows, each with its filter type first
+	size_t rawsize = (size_t)(y1 - y0) * (size_t)(rowsize + 1);
+	uint8_t* raw = (uint8_t*)malloc(rawsize ? rawsize : 1);
+	uint8_t* zeros = (uint8_t*)calloc((size_t)rowsize + 1, 1);
+	// The current and the previous row, byte swapped (16 bit only)
+	uint8_t* swapped = bitdepth == 16 ? (uint8_t*)malloc((size_t)rowsize * 2 + 1) : 0;
+	for( int y = y0; y < y1; ++y )
+	{
+		const uint8_t* row = pixels + (size_t)y * stride;
+		const uint8_t* prev = y > 0 ? row - stride : zeros;
+		if( swapped )
+		{
+			uint8_t* swappedrow = swapped + (size_t)(y & 1) * rowsize;
+			uint8_t* swappedprev = swapped + (size_t)((y + 1) & 1) * rowsize;
+			if( y == y0 && y > 0 )
+				_jc_png_swap16(prev, rowsize, swappedprev);
+			_jc_png_swap16(row, rowsize, swappedrow);
+			row = swappedrow;
+			prev = y > 0 ? swappedprev : zeros;
+		}
+		int f = filter == JC_PNG_FILTER_ADAPTIVE ? _jc_png_choose_filter(row, prev, rowsize, bpp) : (int)filter;
+		uint8_t* out = raw + (size_t)(y - y0) * (rowsize + 1);
+		out[0] = (uint8_t)f;
+		_jc_png_filter_row(f, row, prev, rowsize, bpp, out + 1);
+	}
+	free(swapped);
+	free(zeros);
+
+	// The IDAT chunk type, zlib header (first strip), the deflate data, and room for the worst case of 9 bits per byte
+	_jc_png_bitwriter w;
+	w.data = (uint8_t*)malloc(4 + 2 + rawsize + rawsize / 8 + (rawsize / 65535 + 2) * 5 + 16);
+	w.size = 0;
+	w.bits = 0;
+	w.numbits = 0;
+	memcpy(w.data, "IDAT", 4);
+	w.size = 4;
+	if( y0 == 0 )
+	{
+		w.data[w.size++] = 0x78;
+		w.data[w.size++] = 0x01;
+	}
+
+	int final = y1 == height;
+	if( level == 0 )
+		_jc_png_store(&w, raw, rawsize, final);
+	else
+	{
+		_jc_png_deflate(&w, raw, rawsize, level, final);
+		// The next strip starts on a byte boundary, after an empty stored block
+		if( !final )
+			_jc_png_store(&w, 0, 0, 0);
+		_jc_png_align(&w);
+	}
+
+	strip->data		= w.data;
+	strip->size		= w.size;
+	strip->rawsize	= rawsize;
+	strip->adler	= _jc_png_adler(1, raw, rawsize);
+	strip->crc		= _jc_png_crc(0, w.data, w.size);
+	free(raw);
+}
+
+static void jc_png_free_strip(jc_png_strip* strip)
+{
+	free(strip->data);
+	strip->data = 0;
+}
+
+static void _jc_png_put32(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+// Writes a chunk, from its type and data. Returns 0 on failure
+static int _jc_png_write_chunk(FILE* file, const uint8_t* typeanddata, size_t size, uint32_t crc)
+{
+	uint8_t length[4], crcbytes[4];
+	_jc_png_put32(length, (uint32_t)(size - 4));
+	_jc_png_put32(crcbytes, crc);
+	return fwrite(length, 1, 4, file) == 4 && fwrite(typeanddata, 1, size, file) == size && fwrite(crcbytes, 1, 4, file) == 4;
+}
+
+/** Writes the png file from the strips (encoded with the same channels and bitdepth). Returns 1 on success, 0 on failure
+ */
+static int jc_png_write(const char* path, int width, int height, int channels, int bitdepth, const jc_png_strip* strips, int numstrips)
+{
+	static const uint8_t colortypes[5] = { 0, 0, 4, 2, 6 };	// Gray, gray + alpha, RGB, RGBA
+	FILE* file = fopen(path, "wb");
+	if( !file )
+		return 0;
+
+	static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	uint8_t ihdr[4 + 13] = { 'I', 'H', 'D', 'R' };
+	_jc_png_put32(ihdr + 4, (uint32_t)width);
+	_jc_png_put32(ihdr + 8, (uint32_t)height);
+	ihdr[12] = (uint8_t)bitdepth;
+	ihdr[13] = colortypes[channels];
+	int ok = fwrite(signature, 1, 8, file) == 8 && _jc_png_write_chunk(file, ihdr, sizeof(ihdr), _jc_png_crc(0, ihdr, sizeof(ihdr)));
+
+	uint32_t adler = 1;
+	for( int i = 0; i < numstrips && ok; ++i )
+	{
+		ok = _jc_png_write_chunk(file, strips[i].data, strips[i].size, strips[i].crc);
+		adler = _jc_png_adler_combine(adler, strips[i].adler, strips[i].rawsize);
+	}
+
+	// The zlib stream ends with the Adler-32, in its own chunk
+	uint8_t end[4 + 4] = { 'I', 'D', 'A', 'T' };
+	_jc_png_put32(end + 4, adler);
+	static const uint8_t iend[4] = { 'I', 'E', 'N', 'D' };
+	ok = ok && _jc_png_write_chunk(file, end, sizeof(end), _jc_png_crc(0, end, sizeof(end)));
+	ok = ok && _jc_png_write_chunk(file, iend, sizeof(iend), _jc_png_crc(0, iend, sizeof(iend)));
+	return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,393 @@
+#pragma once
+
+/** Rectangle packers for the glyph atlas
+ *
+ * 	JC_PACK_SHELF		Left to right rows (same as the stbrp fallback in stb_truetype.h)
+ * 	JC_PACK_SKYLINE		Skyline bottom left
+ * 	JC_PACK_MAXRECTS	MaxRects, best short side fit
+ *
+ * The rects are packed in order of decreasing height (then width), which helps all of them.
+ * The input order of the array is left untouched.
+ * jc_pack_rects_pages() spills the rects that don't fit into more pages of the same size.
+ * Based on "A Thousand Ways to Pack the Bin" by Jukka Jylänki
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct _jc_pack_rect
+{
+	int id;				// User data
+	int w, h;			// Input
+	int x, y;			// Output
+	int was_packed;		// Output
+	int page;			// Output (jc_pack_rects_pages)
+} jc_pack_rect;
+
+typedef enum _jc_pack_algorithm
+{
+	JC_PACK_SHELF,
+	JC_PACK_SKYLINE,
+	JC_PACK_MAXRECTS,
+} jc_pack_algorithm;
+
+typedef struct _jc_pack_area
+{
+	int x, y, w, h;
+} _jc_pack_area;
+
+
+static int _jc_pack_cmp_height(const void* _a, const void* _b)
+{
+	const jc_pack_rect* a = *(const jc_pack_rect**)_a;
+	const jc_pack_rect* b = *(const jc_pack_rect**)_b;
+	if( a->h != b->h )
+		return b->h - a->h;
+	if( a->w != b->w )
+		return b->w - a->w;
+	return a < b ? -1 : (a > b ? 1 : 0);	// Keep it deterministic
+}
+
+static void _jc_pack_shelf(int width, int height, jc_pack_rect** rects, int numrects)
+{
+	int x = 0, y = 0, bottom = 0;
+	for( int i = 0; i < numrects; ++i )
+	{
+		jc_pack_rect* r = rects[i];
+		if( x + r->w > width )
+		{
+			x = 0;
+			y = bottom;
+		}
+		if( r->w > width || y + r->h > height )
+			continue;
+		r->x = x;
+		r->y = y;
+		r->was_packed = 1;
+		x += r->w;
+		if( y + r->h > bottom )
+			bottom = y + r->h;
+	}
+}
+
+typedef struct _jc_pack_skyline_node
+{
+	int x, y, w;
+} _jc_pack_skyline_node;
+
+// Returns the y where a rect of width 'w' would sit when placed at node 'index', or -1 if it doesn't fit
+static int _jc_pack_skyline_fit(const _jc_pack_skyline_node* nodes, int numnodes, int index, int w, int h, int width, int height)
+{
+	int x = nodes[index].x;
+	if( x + w > width )
+		return -1;
+	int y = 0;
+	int remaining = w;
+	for( int i = index; remaining > 0; ++i )
+	{
+		if( i == numnodes )
+			return -1;
+		if( nodes[i].y > y )
+			y = nodes[i].y;
+		if( y + h > height )
+			return -1;
+		remaining -= nodes[i].w;
+	}
+	return y;
+}
+
+static void _jc_pack_skyline(int width, int height, jc_pack_rect** rects, int numrects)
+{
+	// There can be at most one node per packed rect, plus the initial one
+	_jc_pack_skyline_node* nodes = (_jc_pack_skyline_node*)malloc((numrects + 2) * sizeof(_jc_pack_skyline_node));
+	int numnodes = 1;
+	nodes[0].x = 0;
+	nodes[0].y = 0;
+	nodes[0].w = width;
+
+	for( int r = 0; r < numrects; ++r )
+	{
+		jc_pack_rect* rect = rects[r];
+		int bestindex = -1;
+		int besttop = height + 1;
+		int bestwidth = width + 1;
+		int besty = 0;
+		for( int i = 0; i < numnodes; ++i )
+		{
+			int y = _jc_pack_skyline_fit(nodes, numnodes, i, rect->w, rect->h, width, height);
+			if( y < 0 )
+				continue;
+			// Bottom left: lowest top edge, then the tightest node
+			if( y + rect->h < besttop || (y + rect->h == besttop && nodes[i].w < bestwidth) )
+			{
+				bestindex = i;
+				besttop = y + rect->h;
+				bestwidth = nodes[i].w;
+				besty = y;
+			}
+		}
+		if( bestindex < 0 )
+			continue;
+
+		rect->x = nodes[bestindex].x;
+		rect->y = besty;
+		rect->was_packed = 1;
+
+		// Insert the new node, and shrink/remove the ones it covers
+		for( int i = numnodes; i > bestindex; --i )
+			nodes[i] = nodes[i - 1];
+		++numnodes;
+		nodes[bestindex].x = rect->x;
+		nodes[bestindex].y = rect->y + rect->h;
+		nodes[bestindex].w = rect->w;
+
+		int right = rect->x + rect->w;
+		int i = bestindex + 1;
+		while( i < numnodes )
+		{
+			if( nodes[i].x >= right )
+				break;
+			int shrink = right - nodes[i].x;
+			if( nodes[i].w > shrink )
+			{
+				nodes[i].x += shrink;
+				nodes[i].w -= shrink;
+				break;
+			}
+			for( int j = i; j < numnodes - 1; ++j )
+				nodes[j] = nodes[j + 1];
+			--numnodes;
+		}
+
+		// Merge neighbours at the same level
+		for( int j = 0; j < numnodes - 1; )
+		{
+			if( nodes[j].y == nodes[j + 1].y )
+			{
+				nodes[j].w += nodes[j + 1].w;
+				for( int k = j + 1; k < numnodes - 1; ++k )
+					nodes[k] = nodes[k + 1];
+				--numnodes;
+			}
+			else
+				++j;
+		}
+	}
+	free(nodes);
+}
+
+typedef struct _jc_pack_freelist
+{
+	_jc_pack_area*	areas;
+	int				count;
+	int				capacity;
+	char*			dead;		// Scratch for the pruning
+} _jc_pack_freelist;
+
+static void _jc_pack_freelist_add(_jc_pack_freelist* list, int x, int y, int w, int h)
+{
+	if( list->count == list->capacity )
+	{
+		list->capacity = list->capacity ? list->capacity * 2 : 64;
+		list->areas = (_jc_pack_area*)realloc(list->areas, list->capacity * sizeof(_jc_pack_area));
+	}
+	_jc_pack_area a = { x, y, w, h };
+	list->areas[list->count++] = a;
+}
+
+static inline int _jc_pack_contains(const _jc_pack_area* a, const _jc_pack_area* b)
+{
+	return b->x >= a->x && b->y >= a->y && b->x + b->w <= a->x + a->w && b->y + b->h <= a->y + a->h;
+}
+
+static void _jc_pack_maxrects(int width, int height, jc_pack_rect** rects, int numrects)
+{
+	_jc_pack_freelist freelist = { 0, 0, 0, 0 };
+	_jc_pack_freelist_add(&freelist, 0, 0, width, height);
+
+	for( int r = 0; r < numrects; ++r )
+	{
+		jc_pack_rect* rect = rects[r];
+
+		// Best short side fit
+		int best = -1;
+		int bestshort = 0x7FFFFFFF;
+		int bestlong = 0x7FFFFFFF;
+		for( int i = 0; i < freelist.count; ++i )
+		{
+			const _jc_pack_area* a = &freelist.areas[i];
+			if( a->w < rect->w || a->h < rect->h )
+				continue;
+			int leftoverw = a->w - rect->w;
+			int leftoverh = a->h - rect->h;
+			int shortside = leftoverw < leftoverh ? leftoverw : leftoverh;
+			int longside = leftoverw < leftoverh ? leftoverh : leftoverw;
+			if( shortside < bestshort || (shortside == bestshort && longside < bestlong) )
+			{
+				best = i;
+				bestshort = shortside;
+				bestlong = longside;
+			}
+		}
+		if( best < 0 )
+			continue;
+
+		_jc_pack_area used = { freelist.areas[best].x, freelist.areas[best].y, rect->w, rect->h };
+		rect->x = used.x;
+		rect->y = used.y;
+		rect->was_packed = 1;
+
+		// Split the free areas that overlap the used area. The new areas go to the end of the list
+		int numold = freelist.count;
+		for( int i = 0; i < numold; )
+		{
+			_jc_pack_area a = freelist.areas[i];
+			if( used.x >= a.x + a.w || used.x + used.w <= a.x || used.y >= a.y + a.h || used.y + used.h <= a.y )
+			{
+				++i;
+				continue;
+			}
+			if( used.x > a.x )
+				_jc_pack_freelist_add(&freelist, a.x, a.y, used.x - a.x, a.h);
+			if( used.x + used.w < a.x + a.w )
+				_jc_pack_freelist_add(&freelist, used.x + used.w, a.y, a.x + a.w - (used.x + used.w), a.h);
+			if( used.y > a.y )
+				_jc_pack_freelist_add(&freelist, a.x, a.y, a.w, used.y - a.y);
+			if( used.y + used.h < a.y + a.h )
+				_jc_pack_freelist_add(&freelist, a.x, used.y + used.h, a.w, a.y + a.h - (used.y + used.h));
+
+			// Remove the split area (swap in the last old one, and move the last new one into its place)
+			--numold;
+			freelist.areas[i] = freelist.areas[numold];
+			freelist.areas[numold] = freelist.areas[freelist.count - 1];
+			--freelist.count;
+		}
+
+		// Prune the areas contained in others. The old ones never contain each other, so only the new ones need checking
+		freelist.dead = (char*)realloc(freelist.dead, freelist.count);
+		memset(freelist.dead, 0, freelist.count);
+		for( int i = numold; i < freelist.count; ++i )
+		{
+			for( int j = 0; j < freelist.count; ++j )
+			{
+				if( i != j && !freelist.dead[j] && _jc_pack_contains(&freelist.areas[j], &freelist.areas[i]) )
+				{
+					freelist.dead[i] = 1;
+					break;
+				}
+			}
+		}
+		for( int j = 0; j < numold; ++j )
+		{
+			for( int i = numold; i < freelist.count; ++i )
+			{
+				if( !freelist.dead[i] && _jc_pack_contains(&freelist.areas[i], &freelist.areas[j]) )
+				{
+					freelist.dead[j] = 1;
+					break;
+				}
+			}
+		}
+		int count = 0;
+		for( int i = 0; i < freelist.count; ++i )
+		{
+			if( !freelist.dead[i] )
+				freelist.areas[count++] = freelist.areas[i];
+		}
+		freelist.count = count;
+	}
+	free(freelist.dead);
+	free(freelist.areas);
+}
+
+/** Packs the rects into a width x height area.
+ * Returns the number of rects that were packed. The ones that didn't fit get 'was_packed' = 0
+ */
+int jc_pack_rects(jc_pack_algorithm algorithm, int width, int height, jc_pack_rect* rects, int numrects)
+{
+	jc_pack_rect** sorted = (jc_pack_rect**)malloc(numrects * sizeof(jc_pack_rect*));
+	for( int i = 0; i < numrects; ++i )
+	{
+		rects[i].x = 0;
+		rects[i].y = 0;
+		rects[i].was_packed = 0;
+		rects[i].page = 0;
+		sorted[i] = &rects[i];
+	}
+	qsort(sorted, numrects, sizeof(jc_pack_rect*), _jc_pack_cmp_height);
+
+	switch( algorithm )
+	{
+	case JC_PACK_SHELF:		_jc_pack_shelf(width, height, sorted, numrects); break;
+	case JC_PACK_SKYLINE:	_jc_pack_skyline(width, height, sorted, numrects); break;
+	default:				_jc_pack_maxrects(width, height, sorted, numrects); break;
+	}
+	free(sorted);
+
+	int numpacked = 0;
+	for( int i = 0; i < numrects; ++i )
+		numpacked += rects[i].was_packed;
+	return numpacked;
+}
+
+/** Packs the rects into as many width x height pages as needed (at most 'maxpages', or unlimited if 0).
+ * Returns the number of pages used, or 0 if some rects couldn't be packed.
+ * Each page is filled as much as possible, before moving on to the next one.
+ */
+int jc_pack_rects_pages(jc_pack_algorithm algorithm, int width, int height, jc_pack_rect* rects, int numrects, int maxpages)
+{
+	jc_pack_rect* remaining = (jc_pack_rect*)malloc((numrects ? numrects : 1) * sizeof(jc_pack_rect));
+	int* indices = (int*)malloc((numrects ? numrects : 1) * sizeof(int));
+	int numremaining = numrects;
+	for( int i = 0; i < numrects; ++i )
+	{
+		remaining[i] = rects[i];
+		indices[i] = i;
+		rects[i].was_packed = 0;
+	}
+
+	int page = 0;
+	while( numremaining > 0 && (maxpages <= 0 || page < maxpages) )
+	{
+		int numpacked = jc_pack_rects(algorithm, width, height, remaining, numremaining);
+		if( numpacked == 0 )
+			break;	// Some rect is larger than the page
+
+		int count = 0;
+		for( int i = 0; i < numremaining; ++i )
+		{
+			if( remaining[i].was_packed )
+			{
+				jc_pack_rect* r = &rects[indices[i]];
+				r->x = remaining[i].x;
+				r->y = remaining[i].y;
+				r->was_packed = 1;
+				r->page = page;
+			}
+			else
+			{
+				remaining[count] = remaining[i];
+				indices[count] = indices[i];
+				++count;
+			}
+		}
+		numremaining = count;
+		++page;
+	}
+	free(indices);
+	free(remaining);
+	return numremaining == 0 ? (page > 0 ? page : 1) : 0;
+}
+
+/** The fraction of the width x height area that is covered by the packed rects
+ */
+float jc_pack_efficiency(int width, int height, const jc_pack_rect* rects, int numrects)
+{
+	double used = 0;
+	for( int i = 0; i < numrects; ++i )
+	{
+		if( rects[i].was_packed )
+			used += (double)rects[i].w * rects[i].h;
+	}
+	return width * height > 0 ? (float)(used / ((double)width * height)) : 0.0f;
+}
@@ -1,8 +1,15 @@
 #pragma once
 
 /** A collection of distance transforms
+ *
+ * The distances d (in units of the radius, negative inside) are stored as 0.5 - d * 0.5, clamped to [0, 1],
+ * in one of the jc_sdf_format's: 0 is 'radius' outside, the edge is at 0.5, and 1 is 'radius' inside.
  */
 
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+
 typedef unsigned char 	u8;
 typedef unsigned int  	u32;
 typedef float  	  		_jc_sdf_float;
@@ -16,6 +23,66 @@ static inline _jc_sdf_float _jc_sdf_clamp01(_jc_sdf_float a)
 	return a < 0.0f ? 0.0f : (a > 1.0f ? 1.0f : a);
 }
 
+typedef enum _jc_sdf_format
+{
+	JC_SDF_FORMAT_R8,		// u8, 0-255
+	JC_SDF_FORMAT_R16,		// uint16_t, 0-65535. For wide effects (glows, shadows) with a large radius, without banding
+	JC_SDF_FORMAT_R16F,		// uint16_t, half float
+} jc_sdf_format;
+
+// The size of a texel (of one channel), in bytes
+#define JC_SDF_FORMAT_SIZE(_F)	((_F) == JC_SDF_FORMAT_R8 ? 1 : 2)
+
+// Rounds to the nearest even half float
+static inline uint16_t jc_sdf_float_to_half(float f)
+{
+	uint32_t x;
+	memcpy(&x, &f, sizeof(x));
+	uint32_t sign = (x >> 16) & 0x8000;
+	x &= 0x7FFFFFFF;
+	if( x >= 0x47800000 )	// Too large, inf or nan
+		return (uint16_t)(sign | (x > 0x7F800000 ? 0x7E00 : 0x7C00));
+	if( x < 0x38800000 )	// Denormal: adding 0.5 shifts the mantissa into place, and rounds it
+	{
+		float d;
+		memcpy(&d, &x, sizeof(d));
+		d += 0.5f;
+		memcpy(&x, &d, sizeof(x));
+		return (uint16_t)(sign | (x - 0x3F000000));
+	}
+	x += ((uint32_t)(15 - 127) << 23) + 0xFFF + ((x >> 13) & 1);
+	return (uint16_t)(sign | (x >> 13));
+}
+
+static inline float jc_sdf_half_to_float(uint16_t h)
+{
+	uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+	uint32_t exponent = (h >> 10) & 0x1F;
+	uint32_t mantissa = h & 0x3FF;
+	float f;
+	if( exponent == 0 )
+	{
+		f = mantissa * (1.0f / 16777216.0f);
+		return sign ? -f : f;
+	}
+	uint32_t x = sign | (exponent == 31 ? 0x7F800000 : (exponent + 127 - 15) << 23) | (mantissa << 13);
+	memcpy(&f, &x, sizeof(f));
+	return f;
+}
+
+/** Stores the distance 'd' (in units of the radius, negative inside) at out[index], as 0.5 - d * 0.5 in the given format
+ */
+static inline void jc_sdf_store(void* out, u32 index, jc_sdf_format format, _jc_sdf_float d)
+{
+	_jc_sdf_float v = _jc_sdf_clamp01(0.5f - d * 0.5f);
+	if( format == JC_SDF_FORMAT_R8 )
+		((u8*)out)[index] = (u8)(v * 255.0f);
+	else if( format == JC_SDF_FORMAT_R16 )
+		((uint16_t*)out)[index] = (uint16_t)(v * 65535.0f + 0.5f);
+	else
+		((uint16_t*)out)[index] = jc_sdf_float_to_half(v);
+}
+
 struct _jc_point_s
 {
 	int16_t x;
@@ -43,6 +110,79 @@ static inline _jc_sdf_float _jc_sdf_distsqr(_jc_sdf_float x1, _jc_sdf_float y1,
 }
 
 
+/** The sweep in jc_sdf_dr_eedtaa3 processes several pixels at once where possible.
+ * The SIMD path gives the same result as the scalar one.
+ * Define JC_SDF_NO_SIMD to force the scalar path.
+ */
+#if !defined(JC_SDF_NO_SIMD) && defined(__AVX__)
+	#include <immintrin.h>
+	#define JC_SDF_SIMD_NAME				"avx"
+	#define JC_SDF_SIMD_WIDTH				8
+	typedef __m256							_jc_sdf_vf;
+	typedef __m256							_jc_sdf_vm;
+	#define _JC_SDF_V_LOAD(P)				_mm256_loadu_ps(P)
+	#define _JC_SDF_V_STORE(P, A)			_mm256_storeu_ps(P, A)
+	#define _JC_SDF_V_SET1(V)				_mm256_set1_ps(V)
+	#define _JC_SDF_V_IOTA()				_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7)
+	#define _JC_SDF_V_ADD(A, B)				_mm256_add_ps(A, B)
+	#define _JC_SDF_V_SUB(A, B)				_mm256_sub_ps(A, B)
+	#define _JC_SDF_V_MUL(A, B)				_mm256_mul_ps(A, B)
+	#define _JC_SDF_V_LT(A, B)				_mm256_cmp_ps(A, B, _CMP_LT_OQ)
+	#define _JC_SDF_V_AND(A, B)				_mm256_and_ps(A, B)
+	#define _JC_SDF_V_OR(A, B)				_mm256_or_ps(A, B)
+	#define _JC_SDF_V_MASKZERO()			_mm256_setzero_ps()
+	#define _JC_SDF_V_SELECT(M, A, B)		_mm256_blendv_ps(B, A, M)
+	#define _JC_SDF_V_ANY(M)				(_mm256_movemask_ps(M) != 0)
+#elif !defined(JC_SDF_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+	#include <emmintrin.h>
+	#define JC_SDF_SIMD_WIDTH				4
+	typedef __m128							_jc_sdf_vf;
+	typedef __m128							_jc_sdf_vm;
+	#define _JC_SDF_V_LOAD(P)				_mm_loadu_ps(P)
+	#define _JC_SDF_V_STORE(P, A)			_mm_storeu_ps(P, A)
+	#define _JC_SDF_V_SET1(V)				_mm_set1_ps(V)
+	#define _JC_SDF_V_IOTA()				_mm_setr_ps(0, 1, 2, 3)
+	#define _JC_SDF_V_ADD(A, B)				_mm_add_ps(A, B)
+	#define _JC_SDF_V_SUB(A, B)				_mm_sub_ps(A, B)
+	#define _JC_SDF_V_MUL(A, B)				_mm_mul_ps(A, B)
+	#define _JC_SDF_V_LT(A, B)				_mm_cmplt_ps(A, B)
+	#define _JC_SDF_V_AND(A, B)				_mm_and_ps(A, B)
+	#define _JC_SDF_V_OR(A, B)				_mm_or_ps(A, B)
+	#define _JC_SDF_V_MASKZERO()			_mm_setzero_ps()
+	#if defined(__SSE4_1__)
+		#include <smmintrin.h>
+		#define JC_SDF_SIMD_NAME			"sse4.1"
+		#define _JC_SDF_V_SELECT(M, A, B)	_mm_blendv_ps(B, A, M)
+	#else
+		#define JC_SDF_SIMD_NAME			"sse2"
+		#define _JC_SDF_V_SELECT(M, A, B)	_mm_or_ps(_mm_and_ps(M, A), _mm_andnot_ps(M, B))
+	#endif
+	#define _JC_SDF_V_ANY(M)				(_mm_movemask_ps(M) != 0)
+#elif !defined(JC_SDF_NO_SIMD) && defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+	#define JC_SDF_SIMD_NAME				"neon"
+	#define JC_SDF_SIMD_WIDTH				4
+	typedef float32x4_t						_jc_sdf_vf;
+	typedef uint32x4_t						_jc_sdf_vm;
+	static const float _jc_sdf_iota[4] = { 0, 1, 2, 3 };
+	#define _JC_SDF_V_LOAD(P)				vld1q_f32(P)
+	#define _JC_SDF_V_STORE(P, A)			vst1q_f32(P, A)
+	#define _JC_SDF_V_SET1(V)				vdupq_n_f32(V)
+	#define _JC_SDF_V_IOTA()				vld1q_f32(_jc_sdf_iota)
+	#define _JC_SDF_V_ADD(A, B)				vaddq_f32(A, B)
+	#define _JC_SDF_V_SUB(A, B)				vsubq_f32(A, B)
+	#define _JC_SDF_V_MUL(A, B)				vmulq_f32(A, B)
+	#define _JC_SDF_V_LT(A, B)				vcltq_f32(A, B)
+	#define _JC_SDF_V_AND(A, B)				vandq_u32(A, B)
+	#define _JC_SDF_V_OR(A, B)				vorrq_u32(A, B)
+	#define _JC_SDF_V_MASKZERO()			vdupq_n_u32(0)
+	#define _JC_SDF_V_SELECT(M, A, B)		vbslq_f32(M, A, B)
+	#define _JC_SDF_V_ANY(M)				(vmaxvq_u32(M) != 0)
+#else
+	#define JC_SDF_SIMD_NAME				"scalar"
+	#define JC_SDF_SIMD_WIDTH				1
+#endif
+
 static _jc_sdf_float _jc_sdf_calc_edge_df(_jc_sdf_float gx, _jc_sdf_float gy, _jc_sdf_float a)
 {
 	_jc_sdf_float df, a1;
@@ -109,19 +249,105 @@ inline _jc_sdf_float _jc_sdf_calc_dist(const u8* image, const _jc_point_f* gradi
 	}
 }
 
-void jc_sdf_dr_eedtaa3(const u8* image, u32 width, u32 height, u8* out, u32 outwidth, u32 radius)
+#if JC_SDF_SIMD_WIDTH > 1
+static inline _jc_sdf_vf _jc_sdf_distsqr_v(_jc_sdf_vf x1, _jc_sdf_vf y1, _jc_sdf_vf x2, _jc_sdf_vf y2)
+{
+	_jc_sdf_vf xdiff = _JC_SDF_V_SUB(x2, x1);
+	_jc_sdf_vf ydiff = _JC_SDF_V_SUB(y2, y1);
+	return _JC_SDF_V_ADD(_JC_SDF_V_MUL(xdiff, xdiff), _JC_SDF_V_MUL(ydiff, ydiff));
+}
+
+// Updates the closest points on row 'y' from the three neighbours on the row above.
+// Processes JC_SDF_SIMD_WIDTH pixels at a time, and returns the first x that wasn't processed in 'outx'
+static int _jc_sdf_sweep_top_simd(_jc_sdf_float* px, _jc_sdf_float* py, _jc_sdf_float* dist, int width, int y, int* outx)
+{
+	const int offsets[3] = { -width-1, -width, -width+1 };
+	const _jc_sdf_vf iota = _JC_SDF_V_IOTA();
+	const _jc_sdf_vf yv = _JC_SDF_V_SET1((_jc_sdf_float)y);
+	_jc_sdf_vm changed = _JC_SDF_V_MASKZERO();
+
+	int x = 1;
+	for( ; x + JC_SDF_SIMD_WIDTH <= width - 1; x += JC_SDF_SIMD_WIDTH )
+	{
+		int i = y * width + x;
+		_jc_sdf_vf xv = _JC_SDF_V_ADD(_JC_SDF_V_SET1((_jc_sdf_float)x), iota);
+		_jc_sdf_vf pxv = _JC_SDF_V_LOAD(px + i);
+		_jc_sdf_vf pyv = _JC_SDF_V_LOAD(py + i);
+		_jc_sdf_vf dv = _JC_SDF_V_LOAD(dist + i);
+
+		for( int o = 0; o < 3; ++o )
+		{
+			int c = i + offsets[o];
+			_jc_sdf_vf cx = _JC_SDF_V_LOAD(px + c);
+			_jc_sdf_vf cy = _JC_SDF_V_LOAD(py + c);
+			_jc_sdf_vf d = _jc_sdf_distsqr_v(xv, yv, cx, cy);
+			_jc_sdf_vm m = _JC_SDF_V_AND(_JC_SDF_V_LT(_JC_SDF_V_LOAD(dist + c), dv), _JC_SDF_V_LT(d, dv));
+			pxv = _JC_SDF_V_SELECT(m, cx, pxv);
+			pyv = _JC_SDF_V_SELECT(m, cy, pyv);
+			dv = _JC_SDF_V_SELECT(m, d, dv);
+			changed = _JC_SDF_V_OR(changed, m);
+		}
+
+		_JC_SDF_V_STORE(px + i, pxv);
+		_JC_SDF_V_STORE(py + i, pyv);
+		_JC_SDF_V_STORE(dist + i, dv);
+	}
+	*outx = x;
+	return _JC_SDF_V_ANY(changed) ? 1 : 0;
+}
+#endif
+
+// Calculates the distances from each pixel on row 'y' to the three closest points on the row below
+static void _jc_sdf_calc_row_dists(const _jc_sdf_float* px, const _jc_sdf_float* py, int width, int y, _jc_sdf_float* rowdist)
+{
+	const int offsets[3] = { width-1, width, width+1 };
+	int x = 1;
+#if JC_SDF_SIMD_WIDTH > 1
+	const _jc_sdf_vf iota = _JC_SDF_V_IOTA();
+	const _jc_sdf_vf yv = _JC_SDF_V_SET1((_jc_sdf_float)y);
+	for( ; x + JC_SDF_SIMD_WIDTH <= width - 1; x += JC_SDF_SIMD_WIDTH )
+	{
+		int i = y * width + x;
+		_jc_sdf_vf xv = _JC_SDF_V_ADD(_JC_SDF_V_SET1((_jc_sdf_float)x), iota);
+		for( int o = 0; o < 3; ++o )
+		{
+			int c = i + offsets[o];
+			_JC_SDF_V_STORE(rowdist + width * o + x, _jc_sdf_distsqr_v(xv, yv, _JC_SDF_V_LOAD(px + c), _JC_SDF_V_LOAD(py + c)));
+		}
+	}
+#endif
+	for( ; x < width - 1; ++x )
+	{
+		int i = y * width + x;
+		for( int o = 0; o < 3; ++o )
+		{
+			int c = i + offsets[o];
+			rowdist[width * o + x] = _jc_sdf_distsqr(x, y, px[c], py[c]);
+		}
+	}
+}
+
+/** Same as jc_sdf_dr_eedtaa3, but does not allocate any memory, and 'out' is in the given format.
+ * The 'temp' array must hold at least JC_SDF_DR_EEDTAA3_TEMPSIZE(width, height) bytes.
+ */
+#define JC_SDF_DR_EEDTAA3_TEMPSIZE(_W, _H) (((_W) * (_H) * 5 + (_W) * 3) * sizeof(_jc_sdf_float))
+
+void jc_sdf_dr_eedtaa3_noalloc(const u8* image, u32 width, u32 height, void* out, u32 outwidth, u32 radius, jc_sdf_format format, void* temp)
 {
 	u32 size = width * height;
-	_jc_point_f* pts = (_jc_point_f*)malloc(size * sizeof(_jc_point_f));
-	_jc_sdf_float* dist = (_jc_sdf_float*)malloc(size * sizeof(_jc_sdf_float));
-	_jc_point_f* gradients = (_jc_point_f*)malloc(size * sizeof(_jc_point_f));
+	// The closest points are stored as separate x/y planes, so that several pixels in a row can be loaded at once
+	_jc_point_f* gradients = (_jc_point_f*)temp;
+	_jc_sdf_float* px = (_jc_sdf_float*)(gradients + size);
+	_jc_sdf_float* py = px + size;
+	_jc_sdf_float* dist = py + size;
+	_jc_sdf_float* rowdist = dist + size;	// 3 rows of distances to the points on the row below
 
 	for( u32 y = 0, i = 0; y < height; ++y )
 	{
 		for( u32 x = 0; x < width; ++x, ++i )
 		{
-			pts[i].x = 0;
-			pts[i].y = 0;
+			px[i] = 0;
+			py[i] = 0;
 			dist[i] = _JC_BIG_VAL;
 
 			if( image[i] == 255 )
@@ -150,9 +376,9 @@ void jc_sdf_dr_eedtaa3(const u8* image, u32 width, u32 height, u8* out, u32 outw
 
 			_jc_sdf_float a = image[i]/255.0f;
 			_jc_sdf_float df = _jc_sdf_calc_edge_df(gradients[i].x, gradients[i].y, a);
-			pts[i].x = x + gradients[i].x * df;
-			pts[i].y = y + gradients[i].y * df;
-			dist[i]	 = _jc_sdf_distsqr( x, y, pts[i].x, pts[i].y );
+			px[i] = x + gradients[i].x * df;
+			py[i] = y + gradients[i].y * df;
+			dist[i]	 = _jc_sdf_distsqr( x, y, px[i], py[i] );
 		}
 	}
 
@@ -160,9 +386,25 @@ void jc_sdf_dr_eedtaa3(const u8* image, u32 width, u32 height, u8* out, u32 outw
 	{																		\
 		int c = i + (OFFSET);												\
 		if(dist[c] < dist[i])	{											\
-			_jc_sdf_float d = _jc_sdf_distsqr(x, y, pts[c].x, pts[c].y);	\
+			_jc_sdf_float d = _jc_sdf_distsqr(x, y, px[c], py[c]);			\
+			if( d < dist[i]) {												\
+				px[i] = px[c];												\
+				py[i] = py[c];												\
+				dist[i] = d;												\
+				changed = 1;												\
+			}																\
+		}																	\
+	}
+
+// Same as CALC_DIST, but with the distance already calculated
+#define CALC_DIST_D( OFFSET, DIST )											\
+	{																		\
+		int c = i + (OFFSET);												\
+		if(dist[c] < dist[i])	{											\
+			_jc_sdf_float d = (DIST);										\
 			if( d < dist[i]) {												\
-				pts[i] = pts[c];											\
+				px[i] = px[c];												\
+				py[i] = py[c];												\
 				dist[i] = d;												\
 				changed = 1;												\
 			}																\
@@ -182,29 +424,45 @@ void jc_sdf_dr_eedtaa3(const u8* image, u32 width, u32 height, u8* out, u32 outw
 
 		for( int y = 1; y < height - 1; ++y )
 		{
-			for( int x = 1; x < width - 1; ++x )
+			int x = 1;
+#if JC_SDF_SIMD_WIDTH > 1
+			// The top neighbours only depend on the previous row, so we can process several pixels at once
+			changed |= _jc_sdf_sweep_top_simd(px, py, dist, width, y, &x);
+#endif
+			for( ; x < width - 1; ++x )
 			{
 				int i = y * width + x;
 
-				// Left and top
+				// Top
 				CALC_DIST( indexoffsets[0] );
 				CALC_DIST( indexoffsets[1] );
 				CALC_DIST( indexoffsets[2] );
+			}
+
+			for( x = 1; x < width - 1; ++x )
+			{
+				int i = y * width + x;
+
+				// Left
 				CALC_DIST( indexoffsets[3] );
 			}
 		}
 
 		for( int y = height-2; y >= 0; --y )
 		{
+			// The distances to the bottom neighbours only depend on the next row,
+			// but the updates must still happen in order, after the right neighbour
+			_jc_sdf_calc_row_dists(px, py, width, y, rowdist);
+
 			for( int x = width-2; x >= 1; --x )
 			{
 				int i = y * width + x;
 
 				// Right and bottom
 				CALC_DIST( indexoffsets[4] );
-				CALC_DIST( indexoffsets[5] );
-				CALC_DIST( indexoffsets[6] );
-				CALC_DIST( indexoffsets[7] );
+				CALC_DIST_D( indexoffsets[5], rowdist[x] );
+				CALC_DIST_D( indexoffsets[6], rowdist[width + x] );
+				CALC_DIST_D( indexoffsets[7], rowdist[width*2 + x] );
 			}
 		}
 
@@ -218,13 +476,127 @@ void jc_sdf_dr_eedtaa3(const u8* image, u32 width, u32 height, u8* out, u32 outw
 		{
 			int i = y * width + x;
 			_jc_sdf_float d = JC_SDF_SQRTFN(dist[i]) * scale * (image[i] > 127 ? -1 : 1);
-			out[i] = (u8)(_jc_sdf_clamp01(0.5f - d * 0.5f) * 255.0f);
+			jc_sdf_store(out, i, format, d);
 		}
 	}
 
 #undef CALC_DIST
+#undef CALC_DIST_D
+}
+
+void jc_sdf_dr_eedtaa3(const u8* image, u32 width, u32 height, u8* out, u32 outwidth, u32 radius)
+{
+	void* temp = malloc(JC_SDF_DR_EEDTAA3_TEMPSIZE(width, height));
+	jc_sdf_dr_eedtaa3_noalloc(image, width, height, out, outwidth, radius, JC_SDF_FORMAT_R8, temp);
+	free(temp);
+}
+
+
+/** Exact Euclidean distance transform (Felzenszwalb & Huttenlocher, "Distance Transforms of Sampled Functions")
+ * Separable, so it costs O(width * height) regardless of the glyph complexity or radius.
+ * The anti aliased pixels are seeded with their approximate distance to the edge (0.5 - coverage)
+ */
+#define _JC_SDF_EDT_INF 1e20f
+
+#define JC_SDF_EDT_TEMPSIZE(_W, _H) (((_W) * (_H) * 2 + ((_W) > (_H) ? (_W) : (_H)) * 4 + 1) * sizeof(_jc_sdf_float))
+
+// 1D squared distance transform of the lower envelope of parabolas rooted at each 'grid' sample
+static void _jc_sdf_edt_1d(_jc_sdf_float* grid, int offset, int stride, int length, _jc_sdf_float* f, int* v, _jc_sdf_float* z)
+{
+	v[0] = 0;
+	z[0] = -_JC_SDF_EDT_INF;
+	z[1] = _JC_SDF_EDT_INF;
+	f[0] = grid[offset];
+
+	for( int q = 1, k = 0; q < length; ++q )
+	{
+		f[q] = grid[offset + q * stride];
+		_jc_sdf_float q2 = (_jc_sdf_float)(q * q);
+		_jc_sdf_float s;
+		do
+		{
+			int r = v[k];
+			s = (f[q] - f[r] + q2 - (_jc_sdf_float)(r * r)) / (_jc_sdf_float)(q - r) * 0.5f;
+		} while( s <= z[k] && --k > -1 );
+
+		++k;
+		v[k] = q;
+		z[k] = s;
+		z[k + 1] = _JC_SDF_EDT_INF;
+	}
+
+	for( int q = 0, k = 0; q < length; ++q )
+	{
+		while( z[k + 1] < q )
+			++k;
+		int r = v[k];
+		_jc_sdf_float qr = (_jc_sdf_float)(q - r);
+		grid[offset + q * stride] = f[r] + qr * qr;
+	}
+}
 
-	free(dist);
-	free(pts);
-	free(gradients);
+static void _jc_sdf_edt_2d(_jc_sdf_float* grid, int width, int height, _jc_sdf_float* f, int* v, _jc_sdf_float* z)
+{
+	for( int x = 0; x < width; ++x )
+		_jc_sdf_edt_1d(grid, x, width, height, f, v, z);
+	for( int y = 0; y < height; ++y )
+		_jc_sdf_edt_1d(grid, y * width, 1, width, f, v, z);
+}
+
+/** Same as jc_sdf_edt, but does not allocate any memory, and 'out' is in the given format.
+ * The 'temp' array must hold at least JC_SDF_EDT_TEMPSIZE(width, height) bytes.
+ */
+void jc_sdf_edt_noalloc(const u8* image, u32 width, u32 height, void* out, u32 outwidth, u32 radius, jc_sdf_format format, void* temp)
+{
+	u32 size = width * height;
+	u32 maxlength = width > height ? width : height;
+	_jc_sdf_float* outer = (_jc_sdf_float*)temp;	// squared distance to the inside, for outside pixels
+	_jc_sdf_float* inner = outer + size;			// squared distance to the outside, for inside pixels
+	_jc_sdf_float* f = inner + size;
+	_jc_sdf_float* z = f + maxlength;
+	int* v = (int*)(z + maxlength + 1);
+
+	for( u32 i = 0; i < size; ++i )
+	{
+		u8 c = image[i];
+		if( c == 255 )
+		{
+			outer[i] = 0;
+			inner[i] = _JC_SDF_EDT_INF;
+		}
+		else if( c == 0 )
+		{
+			outer[i] = _JC_SDF_EDT_INF;
+			inner[i] = 0;
+		}
+		else
+		{
+			_jc_sdf_float a = c / 255.0f;
+			_jc_sdf_float dout = a < 0.5f ? 0.5f - a : 0.0f;
+			_jc_sdf_float din = a > 0.5f ? a - 0.5f : 0.0f;
+			outer[i] = dout * dout;
+			inner[i] = din * din;
+		}
+	}
+
+	_jc_sdf_edt_2d(outer, width, height, f, v, z);
+	_jc_sdf_edt_2d(inner, width, height, f, v, z);
+
+	_jc_sdf_float scale = 1.0f / radius;
+	for( u32 y = 0; y < height; ++y )
+	{
+		for( u32 x = 0; x < width; ++x )
+		{
+			u32 i = y * width + x;
+			_jc_sdf_float d = (JC_SDF_SQRTFN(outer[i]) - JC_SDF_SQRTFN(inner[i])) * scale;
+			jc_sdf_store(out, y * outwidth + x, format, d);
+		}
+	}
+}
+
+void jc_sdf_edt(const u8* image, u32 width, u32 height, u8* out, u32 outwidth, u32 radius)
+{
+	void* temp = malloc(JC_SDF_EDT_TEMPSIZE(width, height));
+	jc_sdf_edt_noalloc(image, width, height, out, outwidth, radius, JC_SDF_FORMAT_R8, temp);
+	free(temp);
 }
@@ -0,0 +1,735 @@
+#pragma once
+
+/** Distance fields calculated directly from the glyph outlines
+ *
+ * The shape is a list of line and quadratic bezier segments, in font units (y up).
+ * Each texel gets its distance from the closest segment, and its sign from the
+ * non zero winding rule, so there is no need to rasterize (or oversample) the glyph first.
+ * A grid over the segments makes sure only the curves within 'radius' of a texel are tested.
+ *
+ * For multi channel distance fields (MSDF), the edges are first colored with jc_sdf_shape_color_edges,
+ * so that the two edges meeting at a corner never share more than one channel. Each channel
+ * then stores the signed pseudo distance to the closest edge of that color, and the shader
+ * reconstructs the sharp corner with median(r, g, b).
+ */
+
+#include "jc_sdf.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JC_SDF_SEGMENT_LINE	1
+#define JC_SDF_SEGMENT_QUAD	2
+
+// Edge colors, one bit per channel
+#define JC_SDF_COLOR_RED		1
+#define JC_SDF_COLOR_GREEN		2
+#define JC_SDF_COLOR_BLUE		4
+#define JC_SDF_COLOR_YELLOW		(JC_SDF_COLOR_RED | JC_SDF_COLOR_GREEN)
+#define JC_SDF_COLOR_MAGENTA	(JC_SDF_COLOR_RED | JC_SDF_COLOR_BLUE)
+#define JC_SDF_COLOR_CYAN		(JC_SDF_COLOR_GREEN | JC_SDF_COLOR_BLUE)
+#define JC_SDF_COLOR_WHITE		(JC_SDF_COLOR_RED | JC_SDF_COLOR_GREEN | JC_SDF_COLOR_BLUE)
+
+typedef struct _jc_sdf_segment
+{
+	_jc_point_f	p[3];		// start, control (quads only), end
+	int			type;		// JC_SDF_SEGMENT_LINE or JC_SDF_SEGMENT_QUAD
+	int			contour;	// Index of the contour the segment belongs to
+	int			color;		// JC_SDF_COLOR_*, only used by the multi channel fields
+} jc_sdf_segment;
+
+typedef struct _jc_sdf_shape
+{
+	jc_sdf_segment*	segments;
+	int				numsegments;
+	int				numcontours;
+} jc_sdf_shape;
+
+
+static inline _jc_point_f _jc_sdf_quad_point(const jc_sdf_segment* s, _jc_sdf_float t)
+{
+	_jc_sdf_float it = 1.0f - t;
+	_jc_point_f p;
+	p.x = it*it*s->p[0].x + 2.0f*it*t*s->p[1].x + t*t*s->p[2].x;
+	p.y = it*it*s->p[0].y + 2.0f*it*t*s->p[1].y + t*t*s->p[2].y;
+	return p;
+}
+
+static void _jc_sdf_shape_add(jc_sdf_shape* shape, int* capacity, const jc_sdf_segment* segment)
+{
+	if( shape->numsegments == *capacity )
+	{
+		*capacity = *capacity ? *capacity * 2 : 32;
+		shape->segments = (jc_sdf_segment*)realloc(shape->segments, *capacity * sizeof(jc_sdf_segment));
+	}
+	shape->segments[shape->numsegments++] = *segment;
+}
+
+// Adds the quad, split at its y extremum so that all segments are monotonic in y (needed by the winding calculation)
+static void _jc_sdf_shape_add_quad(jc_sdf_shape* shape, int* capacity, const jc_sdf_segment* quad)
+{
+	_jc_sdf_float denom = quad->p[0].y - 2.0f * quad->p[1].y + quad->p[2].y;
+	_jc_sdf_float t = denom != 0 ? (quad->p[0].y - quad->p[1].y) / denom : -1.0f;
+	if( t <= 0.0f || t >= 1.0f )
+	{
+		_jc_sdf_shape_add(shape, capacity, quad);
+		return;
+	}
+
+	// de Casteljau
+	_jc_point_f a, b, m;
+	a.x = quad->p[0].x + (quad->p[1].x - quad->p[0].x) * t;
+	a.y = quad->p[0].y + (quad->p[1].y - quad->p[0].y) * t;
+	b.x = quad->p[1].x + (quad->p[2].x - quad->p[1].x) * t;
+	b.y = quad->p[1].y + (quad->p[2].y - quad->p[1].y) * t;
+	m.x = a.x + (b.x - a.x) * t;
+	m.y = a.y + (b.y - a.y) * t;
+	a.y = m.y;	// The tangent is horizontal at the extremum
+	b.y = m.y;
+
+	jc_sdf_segment s = *quad;
+	s.p[1] = a;
+	s.p[2] = m;
+	_jc_sdf_shape_add(shape, capacity, &s);
+	s.p[0] = m;
+	s.p[1] = b;
+	s.p[2] = quad->p[2];
+	_jc_sdf_shape_add(shape, capacity, &s);
+}
+
+void jc_sdf_shape_free(jc_sdf_shape* shape)
+{
+	free(shape->segments);
+	shape->segments = 0;
+	shape->numsegments = 0;
+	shape->numcontours = 0;
+}
+
+#ifdef __STB_INCLUDE_STB_TRUETYPE_H__
+/** Builds the shape from the vertices returned by stbtt_GetGlyphShape
+ * Returns the number of segments
+ */
+int jc_sdf_shape_from_stbtt(jc_sdf_shape* shape, const stbtt_vertex* vertices, int numvertices)
+{
+	int capacity = 0;
+	shape->segments = 0;
+	shape->numsegments = 0;
+	shape->numcontours = 0;
+
+	_jc_point_f last = { 0, 0 };
+	for( int i = 0; i < numvertices; ++i )
+	{
+		const stbtt_vertex* v = &vertices[i];
+		_jc_point_f p = { (_jc_sdf_float)v->x, (_jc_sdf_float)v->y };
+		if( v->type == STBTT_vmove )
+		{
+			shape->numcontours++;
+		}
+		else if( p.x != last.x || p.y != last.y )
+		{
+			jc_sdf_segment s;
+			s.contour = shape->numcontours - 1;
+			s.color = JC_SDF_COLOR_WHITE;
+			s.p[0] = last;
+			s.p[2] = p;
+			if( v->type == STBTT_vcurve )
+			{
+				s.type = JC_SDF_SEGMENT_QUAD;
+				s.p[1].x = v->cx;
+				s.p[1].y = v->cy;
+				_jc_sdf_shape_add_quad(shape, &capacity, &s);
+			}
+			else
+			{
+				s.type = JC_SDF_SEGMENT_LINE;
+				s.p[1].x = (last.x + p.x) * 0.5f;
+				s.p[1].y = (last.y + p.y) * 0.5f;
+				_jc_sdf_shape_add(shape, &capacity, &s);
+			}
+		}
+		last = p;
+	}
+	return shape->numsegments;
+}
+#endif
+
+// The (unnormalized) direction of the segment at its start (t = 0) or end (t = 1)
+static _jc_point_f _jc_sdf_segment_direction(const jc_sdf_segment* s, _jc_sdf_float t)
+{
+	_jc_point_f d;
+	if( s->type == JC_SDF_SEGMENT_LINE )
+	{
+		d.x = s->p[2].x - s->p[0].x;
+		d.y = s->p[2].y - s->p[0].y;
+		return d;
+	}
+	// B'(t) = 2 * ((1-t)(p1 - p0) + t(p2 - p1))
+	d.x = (1.0f - t) * (s->p[1].x - s->p[0].x) + t * (s->p[2].x - s->p[1].x);
+	d.y = (1.0f - t) * (s->p[1].y - s->p[0].y) + t * (s->p[2].y - s->p[1].y);
+	if( d.x == 0 && d.y == 0 )
+	{
+		d.x = s->p[2].x - s->p[0].x;
+		d.y = s->p[2].y - s->p[0].y;
+	}
+	return d;
+}
+
+static int _jc_sdf_is_corner(_jc_point_f a, _jc_point_f b, _jc_sdf_float crossthreshold)
+{
+	_jc_sdf_float la = JC_SDF_SQRTFN(a.x*a.x + a.y*a.y);
+	_jc_sdf_float lb = JC_SDF_SQRTFN(b.x*b.x + b.y*b.y);
+	if( la == 0 || lb == 0 )
+		return 0;
+	_jc_sdf_float dot = (a.x*b.x + a.y*b.y) / (la * lb);
+	_jc_sdf_float cross = (a.x*b.y - a.y*b.x) / (la * lb);
+	return dot <= 0 || fabsf(cross) > crossthreshold;
+}
+
+/** Assigns colors to the segments, so that the edges on each side of a corner differ in at least two channels.
+ * 'anglethreshold' is the smallest direction change (in radians) that counts as a corner (3.0 is a good default)
+ */
+void jc_sdf_shape_color_edges(jc_sdf_shape* shape, _jc_sdf_float anglethreshold)
+{
+	static const int colors[3] = { JC_SDF_COLOR_CYAN, JC_SDF_COLOR_MAGENTA, JC_SDF_COLOR_YELLOW };
+	_jc_sdf_float crossthreshold = sinf(anglethreshold);
+
+	int start = 0;
+	while( start < shape->numsegments )
+	{
+		int contour = shape->segments[start].contour;
+		int end = start;
+		while( end < shape->numsegments && shape->segments[end].contour == contour )
+			++end;
+		int count = end - start;
+		jc_sdf_segment* segments = shape->segments + start;
+
+		// Find the corners, i.e. the segments that start at a corner
+		int numcorners = 0;
+		int firstcorner = -1;
+		for( int i = 0; i < count; ++i )
+		{
+			const jc_sdf_segment* prev = &segments[(i + count - 1) % count];
+			if( _jc_sdf_is_corner(_jc_sdf_segment_direction(prev, 1), _jc_sdf_segment_direction(&segments[i], 0), crossthreshold) )
+			{
+				if( firstcorner < 0 )
+					firstcorner = i;
+				++numcorners;
+			}
+		}
+
+		if( numcorners == 0 )
+		{
+			// Smooth contour
+			for( int i = 0; i < count; ++i )
+				segments[i].color = JC_SDF_COLOR_WHITE;
+		}
+		else if( numcorners == 1 )
+		{
+			// Teardrop: split the contour into three runs, so that the corner still gets two different colors
+			for( int i = 0; i < count; ++i )
+			{
+				int run = (3 * i + 1) / (count > 1 ? count : 1);
+				static const int teardrop[3] = { JC_SDF_COLOR_MAGENTA, JC_SDF_COLOR_WHITE, JC_SDF_COLOR_YELLOW };
+				segments[(firstcorner + i) % count].color = teardrop[run > 2 ? 2 : run];
+			}
+		}
+		else
+		{
+			// Switch color at each corner. The last run must also differ from the first one
+			int spline = 0;
+			for( int i = 0; i < count; ++i )
+			{
+				int index = (firstcorner + i) % count;
+				const jc_sdf_segment* prev = &segments[(index + count - 1) % count];
+				if( i > 0 && _jc_sdf_is_corner(_jc_sdf_segment_direction(prev, 1), _jc_sdf_segment_direction(&segments[index], 0), crossthreshold) )
+					++spline;
+				int color = colors[spline % 3];
+				if( spline == numcorners - 1 && spline % 3 == 0 )
+					color = colors[1];
+				segments[index].color = color;
+			}
+		}
+
+		start = end;
+	}
+}
+
+
+// Solves a*t^3 + b*t^2 + c*t + d = 0, returns the number of real roots
+static int _jc_sdf_solve_cubic(double a, double b, double c, double d, double* roots)
+{
+	if( fabs(a) < 1e-12 )
+	{
+		if( fabs(b) < 1e-12 )
+		{
+			if( fabs(c) < 1e-12 )
+				return 0;
+			roots[0] = -d / c;
+			return 1;
+		}
+		double disc = c*c - 4*b*d;
+		if( disc < 0 )
+			return 0;
+		disc = sqrt(disc);
+		roots[0] = (-c + disc) / (2*b);
+		roots[1] = (-c - disc) / (2*b);
+		return 2;
+	}
+
+	b /= a;
+	c /= a;
+	d /= a;
+	double b2 = b*b;
+	double q = (b2 - 3*c) / 9;
+	double r = (b*(2*b2 - 9*c) + 27*d) / 54;
+	double r2 = r*r;
+	double q3 = q*q*q;
+	if( r2 < q3 )
+	{
+		double t = r / sqrt(q3);
+		t = t < -1 ? -1 : (t > 1 ? 1 : t);
+		t = acos(t);
+		b /= 3;
+		q = -2*sqrt(q);
+		roots[0] = q*cos(t/3) - b;
+		roots[1] = q*cos((t + 2*M_PI)/3) - b;
+		roots[2] = q*cos((t - 2*M_PI)/3) - b;
+		return 3;
+	}
+	double A = -pow(fabs(r) + sqrt(r2 - q3), 1/3.0);
+	if( r < 0 )
+		A = -A;
+	double B = A == 0 ? 0 : q / A;
+	roots[0] = (A + B) - b/3;
+	return 1;
+}
+
+/** Returns the squared distance from 'p' to the segment, and the curve parameter of the closest point in 't'
+ */
+static _jc_sdf_float _jc_sdf_segment_distsqr(const jc_sdf_segment* s, _jc_point_f p, _jc_sdf_float* outt)
+{
+	if( s->type == JC_SDF_SEGMENT_LINE )
+	{
+		_jc_sdf_float dx = s->p[2].x - s->p[0].x;
+		_jc_sdf_float dy = s->p[2].y - s->p[0].y;
+		_jc_sdf_float lensq = dx*dx + dy*dy;
+		_jc_sdf_float t = lensq > 0 ? ((p.x - s->p[0].x) * dx + (p.y - s->p[0].y) * dy) / lensq : 0;
+		t = _jc_sdf_clamp01(t);
+		*outt = t;
+		return _jc_sdf_distsqr(p.x, p.y, s->p[0].x + dx * t, s->p[0].y + dy * t);
+	}
+
+	// B(t) - p = m + 2t*a + t^2*b
+	_jc_sdf_float ax = s->p[1].x - s->p[0].x;
+	_jc_sdf_float ay = s->p[1].y - s->p[0].y;
+	_jc_sdf_float bx = s->p[2].x - 2.0f * s->p[1].x + s->p[0].x;
+	_jc_sdf_float by = s->p[2].y - 2.0f * s->p[1].y + s->p[0].y;
+	_jc_sdf_float mx = s->p[0].x - p.x;
+	_jc_sdf_float my = s->p[0].y - p.y;
+
+	// The closest point is where (B(t) - p) is perpendicular to B'(t)
+	double roots[3];
+	int numroots = _jc_sdf_solve_cubic(bx*bx + by*by, 3.0 * (ax*bx + ay*by), 2.0 * (ax*ax + ay*ay) + (mx*bx + my*by), mx*ax + my*ay, roots);
+
+	_jc_sdf_float best = _jc_sdf_distsqr(p.x, p.y, s->p[0].x, s->p[0].y);
+	_jc_sdf_float bestt = 0;
+	_jc_sdf_float d = _jc_sdf_distsqr(p.x, p.y, s->p[2].x, s->p[2].y);
+	if( d < best )
+	{
+		best = d;
+		bestt = 1;
+	}
+	for( int i = 0; i < numroots; ++i )
+	{
+		if( roots[i] <= 0 || roots[i] >= 1 )
+			continue;
+		_jc_point_f q = _jc_sdf_quad_point(s, (_jc_sdf_float)roots[i]);
+		d = _jc_sdf_distsqr(p.x, p.y, q.x, q.y);
+		if( d < best )
+		{
+			best = d;
+			bestt = (_jc_sdf_float)roots[i];
+		}
+	}
+	*outt = bestt;
+	return best;
+}
+
+// A lower bound of the distance to the segment: The squared distance to the bounding box of the control points
+static inline _jc_sdf_float _jc_sdf_segment_bounds_distsqr(const jc_sdf_segment* s, _jc_point_f p)
+{
+	_jc_sdf_float minx = fminf(s->p[0].x, fminf(s->p[1].x, s->p[2].x));
+	_jc_sdf_float maxx = fmaxf(s->p[0].x, fmaxf(s->p[1].x, s->p[2].x));
+	_jc_sdf_float miny = fminf(s->p[0].y, fminf(s->p[1].y, s->p[2].y));
+	_jc_sdf_float maxy = fmaxf(s->p[0].y, fmaxf(s->p[1].y, s->p[2].y));
+	_jc_sdf_float dx = p.x < minx ? minx - p.x : (p.x > maxx ? p.x - maxx : 0);
+	_jc_sdf_float dy = p.y < miny ? miny - p.y : (p.y > maxy ? p.y - maxy : 0);
+	return dx*dx + dy*dy;
+}
+
+// Returns non zero if the (y monotonic) segment crosses the horizontal line at 'y', and the x coordinate of the crossing
+// The direction of the segment is returned in 'dir'
+static int _jc_sdf_segment_crossing(const jc_sdf_segment* s, _jc_sdf_float y, _jc_sdf_float* outx, int* dir)
+{
+	_jc_sdf_float y0 = s->p[0].y;
+	_jc_sdf_float y2 = s->p[2].y;
+	if( y0 <= y && y < y2 )
+		*dir = 1;
+	else if( y2 <= y && y < y0 )
+		*dir = -1;
+	else
+		return 0;
+
+	_jc_sdf_float t;
+	if( s->type == JC_SDF_SEGMENT_LINE )
+	{
+		t = (y - y0) / (y2 - y0);
+	}
+	else
+	{
+		// a*t^2 + b*t + c = 0
+		double a = y0 - 2.0 * s->p[1].y + y2;
+		double b = 2.0 * (s->p[1].y - y0);
+		double c = y0 - y;
+		if( fabs(a) < 1e-9 )
+			t = (_jc_sdf_float)(-c / b);
+		else
+		{
+			double disc = b*b - 4*a*c;
+			disc = disc < 0 ? 0 : sqrt(disc);
+			double t0 = (-b + disc) / (2*a);
+			double t1 = (-b - disc) / (2*a);
+			t = (_jc_sdf_float)(fabs(t0 - 0.5) < fabs(t1 - 0.5) ? t0 : t1);
+		}
+		t = _jc_sdf_clamp01(t);
+	}
+	*outx = s->type == JC_SDF_SEGMENT_LINE ? s->p[0].x + (s->p[2].x - s->p[0].x) * t : _jc_sdf_quad_point(s, t).x;
+	return 1;
+}
+
+typedef struct _jc_sdf_crossing
+{
+	_jc_sdf_float	x;
+	int				dir;
+} _jc_sdf_crossing;
+
+static int _jc_sdf_crossing_cmp(const void* a, const void* b)
+{
+	_jc_sdf_float xa = ((const _jc_sdf_crossing*)a)->x;
+	_jc_sdf_float xb = ((const _jc_sdf_crossing*)b)->x;
+	return xa < xb ? -1 : (xa > xb ? 1 : 0);
+}
+
+/** A bucket grid over the segments, in texel space.
+ * Each cell lists the segments that are within 'radius' of any point in the cell.
+ */
+typedef struct _jc_sdf_grid
+{
+	jc_sdf_segment*	segments;	// The shape, transformed into texel space (y down)
+	int				numsegments;
+	int				cellsize;
+	int				cellswide;
+	int				cellshigh;
+	int*			celloffsets;	// cellswide*cellshigh+1 offsets into 'cellsegments'
+	int*			cellsegments;
+} _jc_sdf_grid;
+
+static void _jc_sdf_grid_create(_jc_sdf_grid* grid, const jc_sdf_shape* shape, _jc_sdf_float scale, _jc_sdf_float tx, _jc_sdf_float ty,
+								u32 width, u32 height, u32 radius)
+{
+	grid->numsegments = shape->numsegments;
+	grid->segments = (jc_sdf_segment*)malloc(shape->numsegments * sizeof(jc_sdf_segment));
+	for( int i = 0; i < shape->numsegments; ++i )
+	{
+		jc_sdf_segment s = shape->segments[i];
+		for( int p = 0; p < 3; ++p )
+		{
+			s.p[p].x = s.p[p].x * scale + tx;
+			s.p[p].y = -s.p[p].y * scale + ty;
+		}
+		grid->segments[i] = s;
+	}
+
+	grid->cellsize	= radius > 8 ? (int)radius / 2 : 4;
+	grid->cellswide	= (width + grid->cellsize - 1) / grid->cellsize;
+	grid->cellshigh	= (height + grid->cellsize - 1) / grid->cellsize;
+	int numcells	= grid->cellswide * grid->cellshigh;
+	grid->celloffsets = (int*)calloc(numcells + 1, sizeof(int));
+
+	// Two passes: count, then fill
+	int* cellranges = (int*)malloc(shape->numsegments * 4 * sizeof(int));
+	for( int i = 0; i < grid->numsegments; ++i )
+	{
+		const jc_sdf_segment* s = &grid->segments[i];
+		// The control polygon contains the curve
+		_jc_sdf_float minx = fminf(s->p[0].x, fminf(s->p[1].x, s->p[2].x)) - radius;
+		_jc_sdf_float miny = fminf(s->p[0].y, fminf(s->p[1].y, s->p[2].y)) - radius;
+		_jc_sdf_float maxx = fmaxf(s->p[0].x, fmaxf(s->p[1].x, s->p[2].x)) + radius;
+		_jc_sdf_float maxy = fmaxf(s->p[0].y, fmaxf(s->p[1].y, s->p[2].y)) + radius;
+		int* r = &cellranges[i*4];
+		r[0] = (int)floorf(minx / grid->cellsize);
+		r[1] = (int)floorf(miny / grid->cellsize);
+		r[2] = (int)floorf(maxx / grid->cellsize);
+		r[3] = (int)floorf(maxy / grid->cellsize);
+		r[0] = r[0] < 0 ? 0 : r[0];
+		r[1] = r[1] < 0 ? 0 : r[1];
+		r[2] = r[2] >= grid->cellswide ? grid->cellswide - 1 : r[2];
+		r[3] = r[3] >= grid->cellshigh ? grid->cellshigh - 1 : r[3];
+		for( int cy = r[1]; cy <= r[3]; ++cy )
+			for( int cx = r[0]; cx <= r[2]; ++cx )
+				grid->celloffsets[cy * grid->cellswide + cx + 1]++;
+	}
+	for( int c = 0; c < numcells; ++c )
+		grid->celloffsets[c + 1] += grid->celloffsets[c];
+
+	grid->cellsegments = (int*)malloc((grid->celloffsets[numcells] + 1) * sizeof(int));
+	int* fill = (int*)malloc((numcells + 1) * sizeof(int));
+	memcpy(fill, grid->celloffsets, (numcells + 1) * sizeof(int));
+	for( int i = 0; i < grid->numsegments; ++i )
+	{
+		const int* r = &cellranges[i*4];
+		for( int cy = r[1]; cy <= r[3]; ++cy )
+			for( int cx = r[0]; cx <= r[2]; ++cx )
+				grid->cellsegments[fill[cy * grid->cellswide + cx]++] = i;
+	}
+	free(fill);
+	free(cellranges);
+}
+
+static void _jc_sdf_grid_destroy(_jc_sdf_grid* grid)
+{
+	free(grid->segments);
+	free(grid->celloffsets);
+	free(grid->cellsegments);
+}
+
+/** Calculates the non zero winding number for the texel centers of one row
+ * 'inside' must hold 'width' bytes
+ */
+static void _jc_sdf_grid_row_inside(const _jc_sdf_grid* grid, int y, u32 width, _jc_sdf_crossing* crossings, u8* inside)
+{
+	_jc_sdf_float cy = y + 0.5f;
+	int numcrossings = 0;
+	for( int i = 0; i < grid->numsegments; ++i )
+	{
+		_jc_sdf_crossing c;
+		if( _jc_sdf_segment_crossing(&grid->segments[i], cy, &c.x, &c.dir) )
+			crossings[numcrossings++] = c;
+	}
+	qsort(crossings, numcrossings, sizeof(_jc_sdf_crossing), _jc_sdf_crossing_cmp);
+
+	int winding = 0;
+	int c = 0;
+	for( u32 x = 0; x < width; ++x )
+	{
+		_jc_sdf_float cx = x + 0.5f;
+		while( c < numcrossings && crossings[c].x < cx )
+			winding += crossings[c++].dir;
+		inside[x] = winding != 0;
+	}
+}
+
+// The non zero winding rule for a single point
+static int _jc_sdf_grid_is_inside(const _jc_sdf_grid* grid, _jc_point_f p)
+{
+	int winding = 0;
+	for( int i = 0; i < grid->numsegments; ++i )
+	{
+		_jc_sdf_float x;
+		int dir;
+		if( _jc_sdf_segment_crossing(&grid->segments[i], p.y, &x, &dir) && x < p.x )
+			winding += dir;
+	}
+	return winding != 0;
+}
+
+/** Finds out which side of the edges is inside, for each contour.
+ * Contours aren't always consistently oriented (the non zero rule doesn't require it),
+ * so we test the winding just beside the longest segment of each contour.
+ * Returns -1 in 'signs[contour]' if the left side is inside, 1 if the right side is.
+ */
+static void _jc_sdf_grid_contour_signs(const _jc_sdf_grid* grid, int numcontours, _jc_sdf_float* signs)
+{
+	_jc_sdf_float area = 0;
+	for( int i = 0; i < grid->numsegments; ++i )
+	{
+		const _jc_point_f* p = grid->segments[i].p;
+		area += p[0].x * p[1].y - p[1].x * p[0].y;
+		area += p[1].x * p[2].y - p[2].x * p[1].y;
+	}
+	// The fallback: Outer contours dominate the area
+	for( int c = 0; c < numcontours; ++c )
+		signs[c] = area > 0 ? -1.0f : 1.0f;
+
+	for( int c = 0; c < numcontours; ++c )
+	{
+		const jc_sdf_segment* longest = 0;
+		_jc_sdf_float longestlen = 0;
+		for( int i = 0; i < grid->numsegments; ++i )
+		{
+			const jc_sdf_segment* s = &grid->segments[i];
+			_jc_sdf_float len = _jc_sdf_distsqr(s->p[0].x, s->p[0].y, s->p[2].x, s->p[2].y);
+			if( s->contour == c && len > longestlen )
+			{
+				longest = s;
+				longestlen = len;
+			}
+		}
+		if( !longest )
+			continue;
+
+		_jc_point_f mid = longest->type == JC_SDF_SEGMENT_LINE ? longest->p[1] : _jc_sdf_quad_point(longest, 0.5f);
+		_jc_point_f dir = _jc_sdf_segment_direction(longest, 0.5f);
+		_jc_sdf_float len = JC_SDF_SQRTFN(dir.x*dir.x + dir.y*dir.y);
+		_jc_sdf_float eps = 0.05f / len;
+		_jc_point_f left = { mid.x - dir.y * eps, mid.y + dir.x * eps };
+		_jc_point_f right = { mid.x + dir.y * eps, mid.y - dir.x * eps };
+		int leftinside = _jc_sdf_grid_is_inside(grid, left);
+		int rightinside = _jc_sdf_grid_is_inside(grid, right);
+		if( leftinside != rightinside )
+			signs[c] = leftinside ? -1.0f : 1.0f;
+	}
+}
+
+/** The signed pseudo distance from 'p' to the segment, given the closest point parameter 't'
+ * Beyond the end points, the distance is measured to the tangent line, which keeps the corners sharp.
+ * Positive on the left side of the segment.
+ */
+static _jc_sdf_float _jc_sdf_segment_pseudo_dist(const jc_sdf_segment* s, _jc_point_f p, _jc_sdf_float t, _jc_sdf_float distsqr)
+{
+	_jc_point_f dir = _jc_sdf_segment_direction(s, t);
+	_jc_sdf_float len = JC_SDF_SQRTFN(dir.x*dir.x + dir.y*dir.y);
+	if( len == 0 )
+		return JC_SDF_SQRTFN(distsqr);
+	dir.x /= len;
+	dir.y /= len;
+
+	_jc_point_f q = s->type == JC_SDF_SEGMENT_LINE ? s->p[0] : _jc_sdf_quad_point(s, t);
+	if( s->type == JC_SDF_SEGMENT_LINE )
+	{
+		q.x += (s->p[2].x - s->p[0].x) * t;
+		q.y += (s->p[2].y - s->p[0].y) * t;
+	}
+	_jc_sdf_float dx = p.x - q.x;
+	_jc_sdf_float dy = p.y - q.y;
+	_jc_sdf_float cross = dir.x * dy - dir.y * dx;
+	_jc_sdf_float along = dir.x * dx + dir.y * dy;
+	if( (t <= 0 && along < 0) || (t >= 1 && along > 0) )
+		return cross;
+	_jc_sdf_float d = JC_SDF_SQRTFN(distsqr);
+	return cross < 0 ? -d : d;
+}
+
+// Picks the closer segment. Ties (e.g. at the shared end point of two segments) go to the one seen most head on
+static int _jc_sdf_is_closer(const jc_sdf_segment* s, _jc_point_f p, _jc_sdf_float t, _jc_sdf_float d,
+							const jc_sdf_segment* best, _jc_sdf_float bestt, _jc_sdf_float bestd)
+{
+	if( !best || d < bestd - 1e-4f )
+		return 1;
+	if( d > bestd + 1e-4f )
+		return 0;
+	_jc_sdf_float pd = fabsf(_jc_sdf_segment_pseudo_dist(s, p, t, d));
+	_jc_sdf_float bestpd = fabsf(_jc_sdf_segment_pseudo_dist(best, p, bestt, bestd));
+	// The pseudo distance is only larger than the true distance when off the end of the segment
+	return pd > bestpd;
+}
+
+/** Renders the distance field of the shape into 'out', with 'numchannels' interleaved channels:
+ *  1: The true distance
+ *  3: The multi channel (MSDF) pseudo distances (the shape must have been colored with jc_sdf_shape_color_edges)
+ *  4: As 3, with the true distance in the fourth channel
+ * A point (x, y) in font units ends up at texel (x * scale + tx, -y * scale + ty)
+ * 'outstride' is in bytes.
+ * The output is encoded the same way as jc_sdf_dr_eedtaa3 (see jc_sdf_store), in the given format
+ */
+void jc_sdf_shape_render_channels(const jc_sdf_shape* shape, _jc_sdf_float scale, _jc_sdf_float tx, _jc_sdf_float ty,
+								void* out, u32 width, u32 height, u32 outstride, u32 numchannels, jc_sdf_format format, u32 radius)
+{
+	_jc_sdf_grid grid;
+	_jc_sdf_grid_create(&grid, shape, scale, tx, ty, width, height, radius);
+
+	_jc_sdf_crossing* crossings = (_jc_sdf_crossing*)malloc((shape->numsegments + 1) * sizeof(_jc_sdf_crossing));
+	u8* inside = (u8*)malloc(width);
+
+	int multichannel = numchannels >= 3;
+	_jc_sdf_float* contoursigns = (_jc_sdf_float*)malloc((shape->numcontours + 1) * sizeof(_jc_sdf_float));
+	if( multichannel )
+		_jc_sdf_grid_contour_signs(&grid, shape->numcontours, contoursigns);
+
+	_jc_sdf_float radiussq = (_jc_sdf_float)radius * radius;
+	_jc_sdf_float invradius = 1.0f / radius;
+	for( u32 y = 0; y < height; ++y )
+	{
+		_jc_sdf_grid_row_inside(&grid, y, width, crossings, inside);
+
+		const int* cellrow = grid.celloffsets + (y / grid.cellsize) * grid.cellswide;
+		void* outrow = (u8*)out + y * outstride;
+		for( u32 x = 0; x < width; ++x )
+		{
+			_jc_point_f p = { x + 0.5f, y + 0.5f };
+			int cell = x / grid.cellsize;
+			_jc_sdf_float best = radiussq;
+
+			const jc_sdf_segment* channelbest[3] = { 0, 0, 0 };
+			_jc_sdf_float channelt[3] = { 0, 0, 0 };
+			_jc_sdf_float channeld[3] = { radiussq, radiussq, radiussq };
+
+			for( int c = cellrow[cell]; c < cellrow[cell + 1]; ++c )
+			{
+				const jc_sdf_segment* segment = &grid.segments[grid.cellsegments[c]];
+				_jc_sdf_float bound = _jc_sdf_segment_bounds_distsqr(segment, p);
+				if( bound >= best && (!multichannel || (bound >= channeld[0] && bound >= channeld[1] && bound >= channeld[2])) )
+					continue;
+				_jc_sdf_float t;
+				_jc_sdf_float d = _jc_sdf_segment_distsqr(segment, p, &t);
+				if( d < best )
+					best = d;
+
+				if( multichannel )
+				{
+					for( int ch = 0; ch < 3; ++ch )
+					{
+						if( (segment->color & (1 << ch)) && d <= radiussq && _jc_sdf_is_closer(segment, p, t, d, channelbest[ch], channelt[ch], channeld[ch]) )
+						{
+							channelbest[ch] = segment;
+							channelt[ch] = t;
+							channeld[ch] = d;
+						}
+					}
+				}
+			}
+
+			_jc_sdf_float truedist = JC_SDF_SQRTFN(best) * (inside[x] ? -1 : 1);
+			if( !multichannel )
+			{
+				jc_sdf_store(outrow, x * numchannels, format, truedist * invradius);
+				continue;
+			}
+
+			for( int ch = 0; ch < 3; ++ch )
+			{
+				// Without a nearby edge of this color, the channel saturates on the same side as the true distance
+				_jc_sdf_float d = truedist < 0 ? -(_jc_sdf_float)radius : (_jc_sdf_float)radius;
+				if( channelbest[ch] )
+					d = contoursigns[channelbest[ch]->contour] * _jc_sdf_segment_pseudo_dist(channelbest[ch], p, channelt[ch], channeld[ch]);
+				jc_sdf_store(outrow, x * numchannels + ch, format, d * invradius);
+			}
+			if( numchannels > 3 )
+				jc_sdf_store(outrow, x * numchannels + 3, format, truedist * invradius);
+		}
+	}
+
+	free(contoursigns);
+	free(inside);
+	free(crossings);
+	_jc_sdf_grid_destroy(&grid);
+}
+
+/** Renders the (single channel) distance field of the shape into 'out'
+ * See jc_sdf_shape_render_channels
+ */
+void jc_sdf_shape_render(const jc_sdf_shape* shape, _jc_sdf_float scale, _jc_sdf_float tx, _jc_sdf_float ty,
+						u8* out, u32 width, u32 height, u32 outstride, u32 radius)
+{
+	jc_sdf_shape_render_channels(shape, scale, tx, ty, out, width, height, outstride, 1, JC_SDF_FORMAT_R8, radius);
+}
@@ -4,12 +4,14 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <stdarg.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/time.h>
-
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 #define STB_TRUETYPE_IMPLEMENTATION
 #include "stb_truetype.h"
@@ -18,41 +20,249 @@
 #include "sdf.h"
 
 #include "jc_sdf.h"
+#include "jc_sdf_shape.h"
+#include "jc_rectpack.h"
+#include "jc_gpos.h"
+#include "jc_png.h"
+
+#define SDF_ATLAS_IMPLEMENTATION
+#include "sdf_atlas.h"
 
 #include "font.h"
+#include "font_writer.h"
 
 #include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
+#include <string>
+#include <list>
 #include <map>
 
 
 static void Usage()
 {
 	printf("Usage: sdffont [options]\n");
-	printf("\t-i <inputpath> THe .ttf file\n");
+	printf("\t-i <inputpath> THe .ttf or .ttc file ('-' reads from stdin)\n");
+	printf("\t--face <index> The font to use in a .ttc collection (default: 0)\n");
+	printf("\t--batch <manifest> Generates several fonts, one per line, with the same options as the command line.\n");
+	printf("\t\tThe command line options are the defaults, and -j sets the number of concurrent fonts\n");
 	printf("\t-o <outputpath> Determines output format from the suffix\n");
 	printf("\t-s <font size>\n");
-	printf("\t-w <image width>\n");
+	printf("\t--sizes <sizes> Comma separated font sizes. Writes one font per size, named <outputpath>_<size>.font,\n");
+	printf("\t\tand the glyph outlines are only read once\n");
+	printf("\t-r <radius> The distance (in pixels) the field reaches outside and inside the outline\n");
+	printf("\t-w <image width> Use a fixed atlas size, instead of searching for the smallest one. Needs -h too\n");
 	printf("\t-h <image height>\n");
+	printf("\t--atlas-size <pow2|any> The sizes tried when searching for the smallest atlas (default: pow2)\n");
+	printf("\t--max-page-size <size> The largest atlas width and height. Glyphs that don't fit spill over into more pages,\n");
+	printf("\t\twritten as <outputpath>.<page>.png. Rounded down to a power of two with --atlas-size pow2 (default: 8192)\n");
+	printf("\t-j <threads> Number of glyph worker threads (0 = number of cores)\n");
+	printf("\t--sdf-algorithm <eedtaa3|sdf|edt|vector> The distance transform. 'edt' is exact, and linear time.\n");
+	printf("\t\t'vector' calculates the distances from the glyph outlines, and needs no oversampling (default: eedtaa3)\n");
+	printf("\t--packer <shelf|skyline|maxrects> The atlas packing algorithm (default: maxrects)\n");
+	printf("\t--range <ranges> Comma separated code points or inclusive ranges, e.g. 0x20-0x7e,0x400-0x4ff (default: 0x20-0x7e)\n");
+	printf("\t--charset-file <path> Adds the code points found in a UTF-8 text file\n");
+	printf("\t--all-glyphs-in-font Adds every code point the font has a glyph for\n");
+	printf("\t--kerning-pairs Keeps the kerning pair list when the kerning is written as a class matrix\n");
+	printf("\t--cache-dir <dir> Keeps the finished glyphs in this directory, and only generates the ones not found there\n");
+	printf("\t--channels <1|3|4> 1 = sdf, 3 = msdf (rgb), 4 = msdf + sdf in alpha. 3 and 4 use the 'vector' algorithm\n");
+	printf("\t--texel-format <r8|r16|r16f> The size of each channel. The 16 bit formats keep wide effects (glows, shadows)\n");
+	printf("\t\twith a large radius from banding. r16 is written as 16 bit png, r16f needs --atlas raw|lz4 (default: r8)\n");
+	printf("\t--atlas <png|raw|lz4|bc4|eac> Writes the atlas as .png files, or embeds it in the .font file,\n");
+	printf("\t\tas raw texels, LZ4 compressed, or as BC4 / EAC R11 GPU blocks (single channel only) (default: png)\n");
+	printf("\t--atlas-quality <fast|normal|best> The BC4 / EAC R11 encoding quality (default: normal)\n");
+	printf("\t--png-level <0-9> The png compression. 0 is uncompressed, for fast intermediate builds (default: 5)\n");
+	printf("\t--png-filter <none|sub|up|average|paeth|adaptive> The png row filter. 'adaptive' picks one per row (default: adaptive)\n");
+}
+
+struct SFontFile
+{
+	uint8_t*	data;
+	size_t		size;
+	int			mapped;	// 1 if mmap'ed, 0 if read into a malloc'ed buffer
+};
+
+// Reads everything from a stream that can't be mapped (e.g. a pipe)
+static int ReadFontStream(int fd, SFontFile* font)
+{
+	size_t capacity = 1024*1024;
+	font->data = (uint8_t*)malloc(capacity);
+	font->size = 0;
+	font->mapped = 0;
+	for(;;)
+	{
+		if( font->size == capacity )
+		{
+			capacity *= 2;
+			font->data = (uint8_t*)realloc(font->data, capacity);
+		}
+		ssize_t n = read(fd, font->data + font->size, capacity - font->size);
+		if( n == 0 )
+			break;
+		if( n < 0 )
+		{
+			free(font->data);
+			font->data = 0;
+			return 0;
+		}
+		font->size += (size_t)n;
+	}
+	return 1;
 }
 
-uint8_t* ReadFont(const char* path)
+/** Maps the font file read only, so that stbtt_InitFont can use it in place.
+ * Pipes and stdin ("-") are read into memory instead.
+ */
+static int OpenFontFile(const char* path, SFontFile* font)
 {
+	memset(font, 0, sizeof(SFontFile));
+	if( strcmp(path, "-") == 0 )
+		return ReadFontStream(STDIN_FILENO, font);
+
+	int fd = open(path, O_RDONLY);
+	if( fd == -1 )
+		return 0;
+
 	struct stat st;
-	if( stat(path, &st) == -1 )
+	if( fstat(fd, &st) == -1 )
+	{
+		close(fd);
 		return 0;
+	}
+
+	int result;
+	void* data = S_ISREG(st.st_mode) && st.st_size > 0 ? mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	if( data != MAP_FAILED )
+	{
+		// The glyph data is looked up through the tables, not read front to back
+		madvise(data, st.st_size, MADV_RANDOM);
+		font->data = (uint8_t*)data;
+		font->size = (size_t)st.st_size;
+		font->mapped = 1;
+		result = 1;
+	}
+	else
+		result = ReadFontStream(fd, font);
+
+	close(fd);
+	return result;
+}
+
+static void CloseFontFile(SFontFile* font)
+{
+	if( font->mapped )
+		munmap(font->data, font->size);
+	else
+		free(font->data);
+	font->data = 0;
+	font->size = 0;
+}
+
+// Parses "0x20-0x7e,0x400-0x4ff,65". Returns 0 on a syntax error
+static int ParseRanges(const char* s, std::vector<int>& codepoints)
+{
+	while( *s )
+	{
+		char* end;
+		long start = strtol(s, &end, 0);
+		if( end == s )
+			return 0;
+		long last = start;
+		s = end;
+		if( *s == '-' )
+		{
+			++s;
+			last = strtol(s, &end, 0);
+			if( end == s )
+				return 0;
+			s = end;
+		}
+		if( start < 0 || last > 0x10FFFF || last < start )
+			return 0;
+		for( long c = start; c <= last; ++c )
+			codepoints.push_back((int)c);
+		if( *s == ',' )
+			++s;
+		else if( *s )
+			return 0;
+	}
+	return 1;
+}
 
-	uint8_t* buffer = new uint8_t[st.st_size];
+// Parses a comma separated list of integers, e.g. "16,24,32". Returns 0 on error
+static int ParseList(const char* s, std::vector<int>& values)
+{
+	while( *s )
+	{
+		char* end;
+		long value = strtol(s, &end, 10);
+		if( end == s || value < INT_MIN || value > INT_MAX )
+			return 0;
+		values.push_back((int)value);
+		s = end;
+		if( *s == ',' && s[1] )
+			++s;
+		else if( *s )
+			return 0;
+	}
+	return 1;
+}
 
-	FILE* f = fopen(path, "rb");
-	if( 1 != fread(buffer, st.st_size, 1, f) )
+// Decodes one UTF-8 sequence. Invalid bytes are returned as U+FFFD
+static int DecodeUTF8(const uint8_t*& s, const uint8_t* end)
+{
+	uint32_t c = *s++;
+	int numextra = c >= 0xF0 ? 3 : (c >= 0xE0 ? 2 : (c >= 0xC0 ? 1 : 0));
+	if( c >= 0x80 && numextra == 0 )
+		return 0xFFFD;
+	c &= 0x7F >> numextra;
+	for( int i = 0; i < numextra; ++i, ++s )
 	{
-		delete[] buffer;
+		if( s == end || (*s & 0xC0) != 0x80 )
+			return 0xFFFD;
+		c = (c << 6) | (*s & 0x3F);
+	}
+	return c;
+}
+
+// Adds the code points in a UTF-8 text file (control characters, like the line breaks, are skipped)
+static int ReadCharsetFile(const char* path, std::vector<int>& codepoints)
+{
+	FILE* file = fopen(path, "rb");
+	if( !file )
 		return 0;
+	std::vector<uint8_t> text;
+	uint8_t buffer[4096];
+	size_t n;
+	while( (n = fread(buffer, 1, sizeof(buffer), file)) > 0 )
+		text.insert(text.end(), buffer, buffer + n);
+	fclose(file);
+
+	const uint8_t* s = text.empty() ? 0 : &text[0];
+	const uint8_t* end = s + text.size();
+	if( text.size() >= 3 && s[0] == 0xEF && s[1] == 0xBB && s[2] == 0xBF )
+		s += 3;	// BOM
+	while( s < end )
+	{
+		int c = DecodeUTF8(s, end);
+		if( c >= 0x20 && c != 0x7F )
+			codepoints.push_back(c);
 	}
+	return 1;
+}
 
-	fclose(f);
-	return buffer;
+// Adds all code points that map to a glyph
+static void AddAllGlyphsInFont(const stbtt_fontinfo* info, std::vector<int>& codepoints)
+{
+	// Only format 12 and 13 cmaps reach beyond the basic multilingual plane
+	uint16_t format = ttUSHORT(info->data + info->index_map);
+	int lastcodepoint = (format == 12 || format == 13) ? 0x10FFFF : 0xFFFF;
+	for( int c = 0x20; c <= lastcodepoint; ++c )
+	{
+		if( stbtt_FindGlyphIndex(info, c) != 0 )
+			codepoints.push_back(c);
+	}
 }
 
 /*
@@ -77,43 +287,107 @@ static void DrawBox(int x0, int y0, int x1, int y1, uint8_t* image, int width, i
 */
 
 
-uint64_t GetFileOffset(FILE* f)
+/** Groups the glyphs into kerning classes (see SFontKerningClasses), from the (sorted) glyphs and pairs.
+ * Returns 0 if there are no pairs, or if the matrix would be larger than the pairs themselves.
+ */
+static int BuildKerningClasses(const std::vector<SFontGlyph>& glyphs, const std::vector<SFontPairKerning>& pairkernings, std::vector<uint8_t>& out)
 {
-	return (uint64_t)ftell(f);
-}
+	if( pairkernings.empty() )
+		return 0;
 
-static uint64_t Align8(uint64_t pos)
-{
-	uint64_t remainder = pos & (8 - 1);
-	if( remainder )
-		return pos + 8 - remainder;
-	return pos;
-}
+	// The pairs as glyph indices, ordered by the left glyph
+	std::vector<uint32_t> codepoints(glyphs.size());
+	for( size_t i = 0; i < glyphs.size(); ++i )
+		codepoints[i] = glyphs[i].codepoint;
+	std::vector<std::pair<std::pair<uint32_t, uint32_t>, float> > pairs(pairkernings.size());
+	for( size_t i = 0; i < pairkernings.size(); ++i )
+	{
+		uint32_t left = (uint32_t)(std::lower_bound(codepoints.begin(), codepoints.end(), (uint32_t)pairkernings[i].key) - codepoints.begin());
+		uint32_t right = (uint32_t)(std::lower_bound(codepoints.begin(), codepoints.end(), (uint32_t)(pairkernings[i].key >> 32)) - codepoints.begin());
+		pairs[i] = std::make_pair(std::make_pair(left, right), pairkernings[i].kerning);
+	}
+	std::sort(pairs.begin(), pairs.end());
 
-static void AlignFile8(FILE* file)
-{
-	uint64_t pos = GetFileOffset(file);
-	uint64_t nextpos = Align8(pos);
-	uint8_t c = 0;
-	for( uint64_t i = pos; i < nextpos; ++i )
-		fwrite(&c, 1, 1, file);
+	// Left classes: glyphs with identical rows
+	typedef std::vector<std::pair<uint32_t, float> > TKerningRow;
+	std::vector<uint16_t> leftclass(glyphs.size(), 0);
+	std::map<TKerningRow, uint16_t> rows;
+	for( size_t i = 0; i < pairs.size(); )
+	{
+		uint32_t left = pairs[i].first.first;
+		TKerningRow row;
+		for( ; i < pairs.size() && pairs[i].first.first == left; ++i )
+			row.push_back(std::make_pair(pairs[i].first.second, pairs[i].second));
+		std::map<TKerningRow, uint16_t>::iterator it = rows.find(row);
+		if( it == rows.end() )
+		{
+			if( rows.size() + 1 > 0xFFFF )
+				return 0;
+			it = rows.insert(std::make_pair(row, (uint16_t)(rows.size() + 1))).first;
+		}
+		leftclass[left] = it->second;
+	}
+
+	// Right classes: glyphs with identical columns (over the left classes)
+	std::vector<TKerningRow> columns(glyphs.size());
+	for( std::map<TKerningRow, uint16_t>::const_iterator it = rows.begin(); it != rows.end(); ++it )
+	{
+		for( size_t j = 0; j < it->first.size(); ++j )
+			columns[it->first[j].first].push_back(std::make_pair((uint32_t)it->second, it->first[j].second));
+	}
+	std::vector<uint16_t> rightclass(glyphs.size(), 0);
+	std::map<TKerningRow, uint16_t> uniquecolumns;
+	for( size_t g = 0; g < glyphs.size(); ++g )
+	{
+		if( columns[g].empty() )
+			continue;
+		std::sort(columns[g].begin(), columns[g].end());
+		std::map<TKerningRow, uint16_t>::iterator it = uniquecolumns.find(columns[g]);
+		if( it == uniquecolumns.end() )
+		{
+			if( uniquecolumns.size() + 1 > 0xFFFF )
+				return 0;
+			it = uniquecolumns.insert(std::make_pair(columns[g], (uint16_t)(uniquecolumns.size() + 1))).first;
+		}
+		rightclass[g] = it->second;
+	}
+
+	uint32_t numleft = (uint32_t)rows.size() + 1;
+	uint32_t numright = (uint32_t)uniquecolumns.size() + 1;
+	uint64_t size = sizeof(SFontKerningClasses) + glyphs.size() * sizeof(uint16_t) * 2 + (uint64_t)numleft * numright * sizeof(float);
+	if( size > pairkernings.size() * (sizeof(uint64_t) + sizeof(float)) )
+		return 0;
+
+	out.assign(size, 0);
+	SFontKerningClasses* classes = (SFontKerningClasses*)&out[0];
+	classes->num_left	= numleft;
+	classes->num_right	= numright;
+	uint16_t* left		= (uint16_t*)(classes + 1);
+	uint16_t* right		= left + glyphs.size();
+	float* values		= (float*)(right + glyphs.size());
+	memcpy(left, &leftclass[0], glyphs.size() * sizeof(uint16_t));
+	memcpy(right, &rightclass[0], glyphs.size() * sizeof(uint16_t));
+	for( size_t i = 0; i < pairs.size(); ++i )
+		values[leftclass[pairs[i].first.first] * numright + rightclass[pairs[i].first.second]] = pairs[i].second;
+	return 1;
 }
 
-static int WriteFontInfo(const stbtt_fontinfo* info, const char* path, int width, int height, int fontsize, int radius,
-						std::vector<SFontGlyph>& glyphs, std::vector<SFontPairKerning>& pairkernings)
+// The atlas pages are embedded if 'pages' is set. The pair list is left out when the kerning classes are written, unless 'keeppairs' is set
+static int WriteFontInfo(const stbtt_fontinfo* info, const char* path, int width, int height, int numpages, int fontsize, int radius, int numchannels, EFontTexelFormat format,
+						std::vector<SFontGlyph>& glyphs, std::vector<SFontPairKerning>& pairkernings, int keeppairs, const std::vector<unsigned char*>* pages, EFontAtlasCompression compression, jc_blockcomp_quality quality)
 {
 	std::sort(glyphs.begin(), glyphs.end());
 	std::sort(pairkernings.begin(), pairkernings.end());
 
 	SFontHeader header = {};
-	header.magic[0] 			= 'F';
-	header.magic[1] 			= 'O';
-	header.magic[2] 			= 'N';
-	header.magic[3] 			= 'T';
 	header.texturesize_width	= width;
 	header.texturesize_height	= height;
+	header.num_pages			= (uint32_t)numpages;
 	header.fontsize				= fontsize;
 	header.radius				= radius;
+	header.channels				= (uint8_t)numchannels;
+	header.layout				= numchannels == 4 ? FONT_LAYOUT_MTSDF : (numchannels == 3 ? FONT_LAYOUT_MSDF : FONT_LAYOUT_SDF);
+	header.format				= (uint8_t)format;
 
 	float fontscale = stbtt_ScaleForPixelHeight(info, fontsize);
 
@@ -123,80 +397,20 @@ static int WriteFontInfo(const stbtt_fontinfo* info, const char* path, int width
 	header.line_ascend			= lineascent * fontscale;
 	header.line_descend			= linedescend * fontscale;
 	header.line_gap				= linegap * fontscale;
-	header.num_glyphs			= (uint16_t)glyphs.size();
-	header.num_pairkernings		= (uint16_t)pairkernings.size();
-
-	// Offsets into the file where to find data (0 based, i.e from beginning of file)
-	uint64_t offset = sizeof(SFontHeader);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-
-	header.codepoints			= offset;
-	offset += header.num_glyphs * sizeof(uint32_t);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-	header.pairkeys				= offset;
-
-	offset += header.num_pairkernings * sizeof(uint64_t);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-
-	header.pairvalues			= offset;
-	offset += header.num_pairkernings * sizeof(float);
-	offset = Align8(offset);
-	assert( (offset & 7) == 0 );
-	header.glyphs				= offset;
-
-	FILE* file = fopen(path, "wb");
-	if( !file )
-		return 1;
-
-	fwrite(&header, 1, sizeof(header), file);
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.codepoints );
-
-	for( int i = 0; i < glyphs.size(); ++i )
-	{
-		const SFontGlyph& glyph = glyphs[i];
-		fwrite( &glyph.codepoint, 1, sizeof(glyph.codepoint), file );
 
-		//printf("%d: codepoint %d  bb %d, %d, %d, %d   adv %d  bx %d\n", i, glyph.codepoint, glyph.box[0], glyph.box[1], glyph.box[2], glyph.box[3], glyph.advance, glyph.bearing_x );
-	}
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.pairkeys );
-
-	for( int i = 0; i < pairkernings.size(); ++i )
-	{
-		const SFontPairKerning& pk = pairkernings[i];
-		fwrite( &pk.key, 1, sizeof(pk.key), file );
-	}
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.pairvalues );
+	std::vector<uint8_t> kerningclasses;
+	uint32_t numpairkernings = (uint32_t)pairkernings.size();
+	if( BuildKerningClasses(glyphs, pairkernings, kerningclasses) && !keeppairs )
+		numpairkernings = 0;
 
-	for( int i = 0; i < pairkernings.size(); ++i )
-	{
-		const SFontPairKerning& pk = pairkernings[i];
-
-		fwrite( &pk.kerning, 1, sizeof(pk.kerning), file );
-	}
-
-	AlignFile8(file);
-
-	assert( GetFileOffset(file) == header.glyphs );
-
-	for( int i = 0; i < glyphs.size(); ++i )
-	{
-		const SFontGlyph& glyph = glyphs[i];
-		fwrite( &glyph, 1, sizeof(glyph), file);
-	}
+	std::vector<uint8_t> atlas;
+	if( pages )
+		FontBuildAtlas(pages->data(), (uint32_t)numpages, width, height, numchannels, format, compression, quality, atlas);
 
-	return 0;
+	std::vector<uint8_t> data;
+	FontSerialize(&header, glyphs.data(), (uint32_t)glyphs.size(), pairkernings.data(), numpairkernings,
+					kerningclasses.data(), kerningclasses.size(), atlas.data(), atlas.size(), data);
+	return FontWriteFile(path, &data[0], data.size());
 }
 
 
@@ -291,25 +505,9 @@ static int NextPowerOfTwo(int n)
 	return n;
 }
 
-static void Minify2x(unsigned char* image, uint32_t width, uint32_t height)
-{
-	uint32_t halfwidth = width / 2;
-	uint32_t halfheight = height / 2;
-	for( uint32_t ty = 0; ty < halfheight; ++ty)
-	{
-		for( uint32_t tx = 0; tx < halfwidth; ++tx)
-		{
-			float a = image[(ty*2+0) * width + (tx*2+0)];
-			float b = image[(ty*2+0) * width + (tx*2+1)];
-			float c = image[(ty*2+1) * width + (tx*2+0)];
-			float d = image[(ty*2+1) * width + (tx*2+1)];
-			image[ty * halfwidth + tx] = (unsigned char)((a + b + c + d) / 4.0f);
-		}
-	}
-}
-
+// The texel size is in bytes (all the channels)
 static void CopyBitmap(unsigned char* bitmap, uint32_t bitmapwidth, uint32_t bitmapheight,
-						unsigned char* image, uint32_t imagewidth, uint32_t imageheight, uint32_t x, uint32_t y)
+						unsigned char* image, uint32_t imagewidth, uint32_t imageheight, uint32_t x, uint32_t y, uint32_t texelsize)
 {
 	for( uint32_t sy = 0; sy < bitmapheight; ++sy)
 	{
@@ -321,7 +519,8 @@ static void CopyBitmap(unsigned char* bitmap, uint32_t bitmapwidth, uint32_t bit
 			uint32_t tx = x + sx;
 			if(tx >= imagewidth)
 				break;
-			image[ty * imagewidth + tx] = bitmap[sy * bitmapwidth + sx];
+			for( uint32_t c = 0; c < texelsize; ++c )
+				image[(ty * imagewidth + tx) * texelsize + c] = bitmap[(sy * bitmapwidth + sx) * texelsize + c];
 		}
 	}
 }
@@ -338,21 +537,486 @@ static void DebugPrintGlyph(double* bitmap, uint32_t w, uint32_t h)
 	}
 }
 
-int main(int argc, const char** argv)
+static const char* g_AlgorithmNames[] = { "eedtaa3", "sdf", "edt", "vector" };	// Same order as sdf_algorithm
+
+static const char* g_PackerNames[] = { "shelf", "skyline", "maxrects" };	// Same order as jc_pack_algorithm
+
+static const char* g_AtlasCompressionNames[] = { "raw", "lz4", "bc4", "eac" };	// Same order as EFontAtlasCompression
+static const char* g_TexelFormatNames[] = { "r8", "r16", "r16f" };				// Same order as EFontTexelFormat and jc_sdf_format
+
+static const char* g_AtlasQualityNames[] = { "fast", "normal", "best" };	// Same order as jc_blockcomp_quality
+
+static const char* g_PngFilterNames[] = { "none", "sub", "up", "average", "paeth", "adaptive" };	// Same order as jc_png_filter
+
+/** Writes the png, with the strips of rows compressed in parallel
+ * Each strip is at least 64 rows, since the compression restarts for each strip
+ */
+static int WritePng(const char* path, int width, int height, int numchannels, int bitdepth, const uint8_t* pixels, int level, jc_png_filter filter, int numthreads)
+{
+	int numstrips = height / 64 < numthreads ? height / 64 : numthreads;
+	numstrips = numstrips < 1 ? 1 : numstrips;
+	std::vector<jc_png_strip> strips(numstrips);
+	std::vector<std::thread> workers;
+	for( int i = 1; i < numstrips; ++i )
+		workers.push_back( std::thread(jc_png_encode_strip, pixels, width, height, numchannels, bitdepth, 0, height * i / numstrips, height * (i + 1) / numstrips, level, filter, &strips[i]) );
+	jc_png_encode_strip(pixels, width, height, numchannels, bitdepth, 0, 0, height / numstrips, level, filter, &strips[0]);
+	for( size_t t = 0; t < workers.size(); ++t )
+		workers[t].join();
+
+	int result = jc_png_write(path, width, height, numchannels, bitdepth, &strips[0], numstrips);
+	for( int i = 0; i < numstrips; ++i )
+		jc_png_free_strip(&strips[i]);
+	return result ? 0 : 1;
+}
+
+static int TryPack(jc_pack_algorithm packer, jc_pack_rect* rects, int numrects, int width, int height, int* numattempts)
+{
+	++*numattempts;
+	return jc_pack_rects(packer, width, height, rects, numrects) == numrects;
+}
+
+// Finds the smallest height in [minheight, maxheight] where everything fits, or 0.
+// In pow2 mode, only powers of two are tried
+static int FindAtlasHeight(jc_pack_algorithm packer, jc_pack_rect* rects, int numrects, int pow2, int width, int minheight, int maxheight, int* numattempts)
+{
+	if( minheight > maxheight || !TryPack(packer, rects, numrects, width, maxheight, numattempts) )
+		return 0;
+
+	int lo = minheight;
+	int hi = maxheight;	// Always fits
+	if( pow2 )
+	{
+		while( lo < hi )
+		{
+			int mid = NextPowerOfTwo((lo + hi) / 2);
+			if( mid >= hi )
+				mid = hi / 2;
+			if( mid < lo || !TryPack(packer, rects, numrects, width, mid, numattempts) )
+				lo = hi;
+			else
+				hi = mid;
+		}
+		return hi;
+	}
+
+	while( lo < hi )
+	{
+		int mid = lo + (hi - lo) / 2;
+		if( TryPack(packer, rects, numrects, width, mid, numattempts) )
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+	return hi;
+}
+
+/** Searches for the atlas with the smallest area that fits all the rects.
+ * For each candidate width, the height is binary searched. Ties go to the squarer atlas.
+ * If the width and height are given (non zero), only that size is tried.
+ * On success, the rects are left packed in the returned size, and 1 is returned.
+ */
+static int FindAtlasSize(jc_pack_algorithm packer, jc_pack_rect* rects, int numrects, int pow2, int maxsize,
+						int* outwidth, int* outheight, int* numattempts)
+{
+	if( *outwidth > 0 && *outheight > 0 )
+		return TryPack(packer, rects, numrects, *outwidth, *outheight, numattempts);
+
+	int64_t area = 0;
+	int maxw = 1, maxh = 1;
+	for( int i = 0; i < numrects; ++i )
+	{
+		area += (int64_t)rects[i].w * rects[i].h;
+		maxw = rects[i].w > maxw ? rects[i].w : maxw;
+		maxh = rects[i].h > maxh ? rects[i].h : maxh;
+	}
+
+	// The candidate widths
+	std::vector<int> widths;
+	int minwidth = maxw > (int)(area / maxsize) ? maxw : (int)(area / maxsize);
+	if( pow2 )
+	{
+		for( int w = NextPowerOfTwo(minwidth); w <= maxsize; w *= 2 )
+			widths.push_back(w);
+	}
+	else
+	{
+		// Beyond twice the square root, the atlas only gets more elongated
+		int maxwidth = (int)(sqrt((double)area) * 2) + maxw;
+		maxwidth = maxwidth > maxsize ? maxsize : maxwidth;
+		const int numcandidates = 32;
+		for( int c = 0; c <= numcandidates; ++c )
+		{
+			int w = minwidth + (int)((int64_t)(maxwidth - minwidth) * c / numcandidates);
+			if( widths.empty() || w != widths.back() )
+				widths.push_back(w);
+		}
+	}
+
+	int bestwidth = 0;
+	int bestheight = 0;
+	for( size_t i = 0; i < widths.size(); ++i )
+	{
+		int w = widths[i];
+		int minheight = (int)((area + w - 1) / w);
+		minheight = minheight > maxh ? minheight : maxh;
+		if( pow2 )
+			minheight = NextPowerOfTwo(minheight);
+		int h = FindAtlasHeight(packer, rects, numrects, pow2, w, minheight, maxsize, numattempts);
+		if( !h )
+			continue;
+
+		int64_t a = (int64_t)w * h;
+		int64_t besta = (int64_t)bestwidth * bestheight;
+		if( !bestwidth || a < besta || (a == besta && abs(w - h) < abs(bestwidth - bestheight)) )
+		{
+			bestwidth = w;
+			bestheight = h;
+		}
+	}
+
+	*outwidth = bestwidth ? bestwidth : maxsize;
+	*outheight = bestwidth ? bestheight : maxsize;
+	// Leave the rects in their final positions (the packing is deterministic)
+	return TryPack(packer, rects, numrects, *outwidth, *outheight, numattempts);
+}
+
+// Per thread work buffers, large enough to hold the biggest (oversampled) glyph
+struct SGlyphScratch
+{
+	unsigned char*	bitmap;
+	unsigned char*	bitmapsdf;
+	unsigned char*	sdftemp;
+	uint64_t		totaltime;
+	uint64_t		totaltimesdf;
+};
+
+struct SFontOutlines
+{
+	std::vector<int>			codepoints;	// Sorted, and all of them are in the font
+	std::vector<sdf_glyph_outline>	glyphs;	// One per code point, prepared once, and shared by all sizes of the font
+	float						flattenscale;	// 0 for the vector algorithm
+};
+
+/** An on disk cache of finished glyph tiles.
+ * Each file is named after the hash of everything the tile depends on, so changing the font, or any of the
+ * settings, simply misses the cache. Stale files are never overwritten, and can be deleted at any time.
+ */
+#define GLYPH_CACHE_VERSION 1
+
+struct SGlyphCacheKey
+{
+	uint64_t	fonthash;		// Hash of the font file
+	int32_t		faceindex;
+	int32_t		glyph;
+	int32_t		fontsize;
+	int32_t		radius;
+	int32_t		numoversampling;
+	int32_t		padding[4];
+	int32_t		algorithm;
+	int32_t		numchannels;
+	float		flattenscale;	// The scale the contours were flattened for (see CreateOutlines)
+	int32_t		version;
+	int32_t		format;			// EFontTexelFormat
+};
+
+struct SGlyphCacheHeader
+{
+	char			magic[4];	// "SDFG"
+	uint16_t		width;
+	uint16_t		height;
+	SGlyphCacheKey	key;		// To detect hash collisions
+	float			offset[2];
+	float			advance;
+	float			bearing_x;
+	// Followed by the width * height texels (numchannels in the format)
+};
+
+struct SGlyphCache
+{
+	const char*			dir;
+	SGlyphCacheKey		key;		// The glyph is set per glyph
+	std::atomic<int>	numhits;
+	std::atomic<int>	nummisses;
+};
+
+// FNV-1a
+static uint64_t HashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const uint8_t* p = (const uint8_t*)data;
+	for( size_t i = 0; i < size; ++i )
+	{
+		hash ^= p[i];
+		hash *= 0x100000001B3ULL;
+	}
+	return hash;
+}
+
+static void GetCachedGlyphPath(const SGlyphCache* cache, const SGlyphCacheKey* key, char* path, size_t pathsize)
+{
+	uint64_t hash = HashBytes(key, sizeof(SGlyphCacheKey), 0xCBF29CE484222325ULL);
+	snprintf(path, pathsize, "%s/%016llx.glyph", cache->dir, (unsigned long long)hash);
+}
+
+static int ReadCachedGlyph(SGlyphCache* cache, int glyph, int width, int height, int texelsize, unsigned char* tile, SFontGlyph* outglyph)
+{
+	SGlyphCacheKey key = cache->key;
+	key.glyph = glyph;
+	char path[1024];
+	GetCachedGlyphPath(cache, &key, path, sizeof(path));
+
+	FILE* file = fopen(path, "rb");
+	if( !file )
+	{
+		cache->nummisses++;
+		return 0;
+	}
+	SGlyphCacheHeader header;
+	size_t tilesize = (size_t)width * height * texelsize;
+	int ok = fread(&header, sizeof(header), 1, file) == 1 && memcmp(header.magic, "SDFG", 4) == 0 &&
+			memcmp(&header.key, &key, sizeof(key)) == 0 && header.width == width && header.height == height &&
+			(tilesize == 0 || fread(tile, tilesize, 1, file) == 1);
+	fclose(file);
+	if( !ok )
+	{
+		cache->nummisses++;
+		return 0;
+	}
+
+	outglyph->offset[0]	= header.offset[0];
+	outglyph->offset[1]	= header.offset[1];
+	outglyph->advance	= header.advance;
+	outglyph->bearing_x	= header.bearing_x;
+	cache->numhits++;
+	return 1;
+}
+
+static void WriteCachedGlyph(const SGlyphCache* cache, int glyph, int width, int height, int texelsize, const unsigned char* tile, const SFontGlyph* glyphinfo)
+{
+	SGlyphCacheHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, "SDFG", 4);
+	header.width		= (uint16_t)width;
+	header.height		= (uint16_t)height;
+	header.key			= cache->key;
+	header.key.glyph	= glyph;
+	header.offset[0]	= glyphinfo->offset[0];
+	header.offset[1]	= glyphinfo->offset[1];
+	header.advance		= glyphinfo->advance;
+	header.bearing_x	= glyphinfo->bearing_x;
+
+	char path[1024];
+	GetCachedGlyphPath(cache, &header.key, path, sizeof(path));
+
+	// Write to a temporary file first, so that concurrent runs never see a partial file
+	char temppath[1100];
+	snprintf(temppath, sizeof(temppath), "%s.%d.%p.tmp", path, (int)getpid(), (const void*)&header);
+	FILE* file = fopen(temppath, "wb");
+	if( !file )
+		return;
+	size_t tilesize = (size_t)width * height * texelsize;
+	int ok = fwrite(&header, sizeof(header), 1, file) == 1 && (tilesize == 0 || fwrite(tile, tilesize, 1, file) == 1);
+	ok = fclose(file) == 0 && ok;
+	if( !ok || rename(temppath, path) != 0 )
+		remove(temppath);
+}
+
+// Shared (read only) state for the glyph workers. Each glyph writes to its own packed rect in 'pages', and its own slot in 'outglyphs'
+struct SGlyphContext
+{
+	const stbtt_fontinfo*	font;
+	const sdf_glyph_outline*	outlines;	// One per pack rect
+	SGlyphCache*			cache;			// 0 if not used
+	const jc_pack_rect*		packrects;
+	int						numrects;
+	sdf_glyph_params		params;
+	uint32_t				maxglyphsize;
+	unsigned char**			pages;			// One image per atlas page
+	int						imagewidth;
+	int						imageheight;
+	SFontGlyph*				outglyphs;
+	std::atomic<int>		next;			// The next glyph to process
+};
+
+static void CreateGlyphScratch(SGlyphScratch* scratch, uint32_t maxglyphsize)
+{
+	scratch->sdftemp		= (unsigned char*)malloc(sdf_glyph_temp_size(maxglyphsize));
+	scratch->bitmap			= new unsigned char[maxglyphsize*maxglyphsize];
+	scratch->bitmapsdf		= new unsigned char[maxglyphsize*maxglyphsize*4*2];	// Up to 4 channels of 16 bits
+	scratch->totaltime		= 0;
+	scratch->totaltimesdf	= 0;
+}
+
+static void DestroyGlyphScratch(SGlyphScratch* scratch)
+{
+	free(scratch->sdftemp);
+	delete[] scratch->bitmap;
+	delete[] scratch->bitmapsdf;
+}
+
+static void GenerateGlyph(SGlyphContext* ctx, SGlyphScratch* scratch, int i)
+{
+	const stbtt_fontinfo* f		= ctx->font;
+	const jc_pack_rect* packrects	= ctx->packrects;
+	const sdf_glyph_params* params	= &ctx->params;
+	int texelsize				= params->numchannels * JC_SDF_FORMAT_SIZE(params->format);
+	unsigned char* bitmap		= scratch->bitmap;
+	unsigned char* bitmapsdf	= scratch->bitmapsdf;
+
+	int codepoint = packrects[i].id;
+	const sdf_glyph_outline* outline = &ctx->outlines[i];
+	int glyph = outline->glyph;
+
+	SFontGlyph& outglyph = ctx->outglyphs[i];
+	outglyph.codepoint = codepoint;
+	outglyph.box[0]	= packrects[i].x;
+	outglyph.box[1]	= packrects[i].y;
+	outglyph.box[2]	= (packrects[i].x + packrects[i].w);
+	outglyph.box[3]	= (packrects[i].y + packrects[i].h);
+	outglyph.page		= (uint16_t)packrects[i].page;
+	outglyph._pad		= 0;
+
+	// The finished tile, and the metrics, may be in the cache already
+	if( ctx->cache && ReadCachedGlyph(ctx->cache, glyph, packrects[i].w, packrects[i].h, texelsize, bitmapsdf, &outglyph) )
+	{
+		if( packrects[i].was_packed )
+			CopyBitmap(bitmapsdf, packrects[i].w, packrects[i].h, ctx->pages[packrects[i].page], ctx->imagewidth, ctx->imageheight, packrects[i].x, packrects[i].y, texelsize);
+		return;
+	}
+
+	assert(ctx->maxglyphsize >= (uint32_t)packrects[i].w * params->numoversampling);
+	assert(ctx->maxglyphsize >= (uint32_t)packrects[i].h * params->numoversampling);
+
+	uint64_t ts = gettime();
+	sdf_glyph_rasterize(f, params, outline, packrects[i].w, packrects[i].h, bitmap);
+
+	uint64_t te = gettime();
+	scratch->totaltime += te - ts;
+
+	ts = gettime();
+	sdf_glyph_transform(f, params, outline, packrects[i].w, packrects[i].h, bitmap, bitmapsdf, scratch->sdftemp);
+
+	te = gettime();
+	scratch->totaltimesdf += te-ts;
+	scratch->totaltime += te-ts;
+
+	// Glyphs that didn't fit have no valid rect, and would overwrite the others
+	if( packrects[i].was_packed )
+		CopyBitmap(bitmapsdf, packrects[i].w, packrects[i].h, ctx->pages[packrects[i].page], ctx->imagewidth, ctx->imageheight, packrects[i].x, packrects[i].y, texelsize);
+
+	sdf_glyph_metrics(f, glyph, params, outglyph.offset, &outglyph.advance, &outglyph.bearing_x);
+
+	if( ctx->cache )
+		WriteCachedGlyph(ctx->cache, glyph, packrects[i].w, packrects[i].h, texelsize, bitmapsdf, &outglyph);
+}
+
+static bool GlyphLess(const std::pair<int, int>& a, const std::pair<int, int>& b)
+{
+	return a.first < b.first;
+}
+
+static void GlyphWorker(SGlyphContext* ctx, SGlyphScratch* scratch)
+{
+	int i;
+	while( (i = ctx->next++) < ctx->numrects )
+		GenerateGlyph(ctx, scratch, i);
+}
+
+// All the settings for generating one font
+struct SFontOptions
+{
+	const char*				inputfile;
+	const char*				outputfile;
+	const char*				batchfile;
+	int						faceindex;		// The font in a .ttc collection
+	int						fontsize;
+	std::vector<int>		sizes;			// --sizes: One font per size, sharing the outlines
+	int						radius;
+	int						padding[4];
+	int						numoversampling;
+	int						numthreads;
+	sdf_algorithm			algorithm;
+	int						numchannels;
+	jc_pack_algorithm		packer;
+	int						fixedwidth;
+	int						fixedheight;
+	int						atlaspow2;
+	int						maxpagesize;
+	std::vector<int>		codepoints;
+	const char*				charsetfile;
+	int						allglyphs;
+	int						keeppairs;		// Writes the pair list also when the kerning classes are written
+	int						verbose;
+	int						embedatlas;		// Embeds the atlas in the .font file, instead of writing .png files
+	EFontAtlasCompression	atlascompression;
+	jc_blockcomp_quality	atlasquality;	// For the bc4 and eac atlases
+	EFontTexelFormat		format;
+	int						pnglevel;		// 0 (stored) to 9
+	jc_png_filter			pngfilter;
+	const char*				cachedir;		// The glyph cache, or 0
+	const stbtt_fontinfo*	font;			// Set when the font has been loaded
+	uint64_t				fonthash;		// Set when the font has been loaded, and the cache is used
+	const SFontOutlines*	outlines;		// Set when the outlines are shared with other sizes
+};
+
+static void InitOptions(SFontOptions* options)
+{
+	options->inputfile			= 0;
+	options->outputfile			= "output.png";
+	options->batchfile			= 0;
+	options->faceindex			= 0;
+	options->fontsize			= 32;
+	options->radius				= 0;
+	memset(options->padding, 0, sizeof(options->padding));
+	options->numoversampling	= 1;
+	options->numthreads			= 1;
+	options->algorithm			= SDF_ALGORITHM_EEDTAA3;
+	options->numchannels		= 1;
+	options->packer				= JC_PACK_MAXRECTS;
+	options->fixedwidth			= 0;
+	options->fixedheight		= 0;
+	options->atlaspow2			= 1;
+	options->maxpagesize		= 8192;
+	options->charsetfile		= 0;
+	options->allglyphs			= 0;
+	options->keeppairs			= 0;
+	options->verbose			= 1;
+	options->embedatlas			= 0;
+	options->atlascompression	= FONT_ATLAS_RAW;
+	options->atlasquality		= JC_BLOCKCOMP_QUALITY_NORMAL;
+	options->format				= FONT_FORMAT_R8;
+	options->pnglevel			= 5;
+	options->pngfilter			= JC_PNG_FILTER_ADAPTIVE;
+	options->cachedir			= 0;
+	options->font				= 0;
+	options->fonthash			= 0;
+	options->outlines			= 0;
+}
+
+// The log goes to stderr when the font itself is written to stdout
+static FILE* LogFile(const SFontOptions* options)
+{
+	return strcmp(options->outputfile, "-") == 0 ? stderr : stdout;
+}
+
+static void Info(const SFontOptions* options, const char* format, ...)
 {
-	int fontsize = 32;
-	int radius = 0;
-	int padding[4] = { 0 };
-	int numoversampling = 1;
-	const char* inputfile = 0;
-	const char* outputfile = "output.png";
+	if( !options->verbose )
+		return;
+	va_list args;
+	va_start(args, format);
+	vfprintf(LogFile(options), format, args);
+	va_end(args);
+}
 
+// Parses the command line options on top of the ones already in 'options'. Returns non zero on error
+static int ParseOptions(int argc, const char** argv, SFontOptions* options)
+{
 	for( int i = 1; i < argc; ++i )
 	{
 		if(strcmp(argv[i], "-i") == 0)
 		{
 			if( i+1 < argc )
-				inputfile = argv[i+1];
+				options->inputfile = argv[i+1];
 			else
 			{
 				Usage();
@@ -362,7 +1026,7 @@ int main(int argc, const char** argv)
 		else if(strcmp(argv[i], "-o") == 0)
 		{
 			if( i+1 < argc )
-				outputfile = argv[i+1];
+				options->outputfile = argv[i+1];
 			else
 			{
 				Usage();
@@ -372,7 +1036,7 @@ int main(int argc, const char** argv)
 		else if(strcmp(argv[i], "--paddingleft") == 0)
 		{
 			if( i+1 < argc )
-				padding[0] = (int)atol(argv[i+1]);
+				options->padding[0] = (int)atol(argv[i+1]);
 			else
 			{
 				Usage();
@@ -382,7 +1046,7 @@ int main(int argc, const char** argv)
 		else if(strcmp(argv[i], "--paddingright") == 0)
 		{
 			if( i+1 < argc )
-				padding[2] = (int)atol(argv[i+1]);
+				options->padding[2] = (int)atol(argv[i+1]);
 			else
 			{
 				Usage();
@@ -392,7 +1056,7 @@ int main(int argc, const char** argv)
 		else if(strcmp(argv[i], "--paddingtop") == 0)
 		{
 			if( i+1 < argc )
-				padding[1] = (int)atol(argv[i+1]);
+				options->padding[1] = (int)atol(argv[i+1]);
 			else
 			{
 				Usage();
@@ -402,7 +1066,7 @@ int main(int argc, const char** argv)
 		else if(strcmp(argv[i], "--paddingbottom") == 0)
 		{
 			if( i+1 < argc )
-				padding[3] = (int)atol(argv[i+1]);
+				options->padding[3] = (int)atol(argv[i+1]);
 			else
 			{
 				Usage();
@@ -412,7 +1076,7 @@ int main(int argc, const char** argv)
 		else if(strcmp(argv[i], "-s") == 0)
 		{
 			if( i+1 < argc )
-				fontsize = (int)atol(argv[i+1]);
+				options->fontsize = (int)atol(argv[i+1]);
 			else
 			{
 				Usage();
@@ -422,304 +1086,1101 @@ int main(int argc, const char** argv)
 		else if(strcmp(argv[i], "-r") == 0)
 		{
 			if( i+1 < argc )
-				radius = (int)atol(argv[i+1]);
+				options->radius = (int)atol(argv[i+1]);
 			else
 			{
 				Usage();
 				return 1;
 			}
 		}
-		else if(strcmp(argv[i], "--numoversampling") == 0)
+		else if(strcmp(argv[i], "-j") == 0)
 		{
 			if( i+1 < argc )
-				numoversampling = (int)atol(argv[i+1]);
+				options->numthreads = (int)atol(argv[i+1]);
 			else
 			{
 				Usage();
 				return 1;
 			}
 		}
-	}
-	if( !inputfile )
-	{
-		fprintf(stderr, "You have to specify an input file!\n");
-		Usage();
-		return 1;
-	}
-
-	uint8_t* fontfile = ReadFont(inputfile);
-	if( !fontfile )
-	{
-		fprintf(stderr, "Failed to read %s\n", inputfile);
-		return 1;
-	}
-
-	printf("Font is %s, chosen height is %d\n", inputfile, fontsize);
-	printf("Outline radius is %d\n", radius);
-
-	{
-		stbtt_fontinfo f;
-		if( !stbtt_InitFont(&f, fontfile, 0) )
-		{
-			fprintf(stderr, "Failed to init font %s\n", inputfile);
-			return 1;
-		}
-		float scale = stbtt_ScaleForPixelHeight(&f, fontsize * numoversampling);
-
-		int ranges[] = { 32, 32+95 };
-
-		int totalnumcodepoints = 0;
-		for( int r = 0; r < sizeof(ranges)/sizeof(ranges[0])/2; ++r)
+		else if(strcmp(argv[i], "--sdf-algorithm") == 0)
 		{
-			int rangestart = ranges[r*2+0];
-			int rangeend = ranges[r*2+1];
-			totalnumcodepoints += rangeend - rangestart;
+			if( i+1 < argc )
+			{
+				int found = 0;
+				for( int a = 0; a < (int)(sizeof(g_AlgorithmNames)/sizeof(g_AlgorithmNames[0])); ++a )
+				{
+					if( strcmp(argv[i+1], g_AlgorithmNames[a]) == 0 )
+					{
+						options->algorithm = (sdf_algorithm)a;
+						found = 1;
+					}
+				}
+				if( !found )
+				{
+					fprintf(stderr, "Unknown sdf algorithm: %s\n", argv[i+1]);
+					Usage();
+					return 1;
+				}
+			}
+			else
+			{
+				Usage();
+				return 1;
+			}
 		}
-
-		int numrects = totalnumcodepoints;
-		stbrp_rect* packrects = new stbrp_rect[numrects];
-		int c = 0;
-		int area = 0;
-		for( int r = 0; r < sizeof(ranges)/sizeof(ranges[0])/2; ++r)
+		else if(strcmp(argv[i], "-w") == 0)
 		{
-			int rangestart = ranges[r*2+0];
-			int rangeend = ranges[r*2+1];
-			for( int codepoint = rangestart; codepoint < rangeend; ++codepoint, ++c )
+			if( i+1 < argc )
+				options->fixedwidth = (int)atol(argv[i+1]);
+			else
 			{
-				packrects[c].id = codepoint;
-				int glyph = stbtt_FindGlyphIndex(&f, codepoint);
-
-				int bbox[4];
-				stbtt_GetGlyphBitmapBox(&f, glyph, scale ,scale, &bbox[0], &bbox[1], &bbox[2], &bbox[3]);
-
-
-				packrects[c].w = bbox[2] - bbox[0];
-				packrects[c].h = bbox[3] - bbox[1];
-				packrects[c].w /= numoversampling;
-				packrects[c].h /= numoversampling;
-				packrects[c].w += padding[0] + padding[2] + radius*2;
-				packrects[c].h += padding[1] + padding[3] + radius*2;
-
-				area += packrects[c].w * packrects[c].h;
+				Usage();
+				return 1;
 			}
 		}
-
-		int imagewidth = (int)sqrtf(area);
-		imagewidth = NextPowerOfTwo(imagewidth);
-		int imageheight = 1;
-		while( imagewidth * imageheight < area )
+		else if(strcmp(argv[i], "-h") == 0)
 		{
-			if( imagewidth <= imageheight )
-				imagewidth *= 2;
+			if( i+1 < argc )
+				options->fixedheight = (int)atol(argv[i+1]);
 			else
-				imageheight *= 2;
+			{
+				Usage();
+				return 1;
+			}
 		}
-		printf("area: %d\n", area);
-		printf("initial w/h: %d x %d\n", imagewidth, imageheight);
-
-		stbrp_context packctx;
-		int numnodes = imagewidth;
-		stbrp_node* packnodes = new stbrp_node[numnodes];
-		int numtries = 3;
-		while(--numtries > 0)
+		else if(strcmp(argv[i], "--atlas-size") == 0)
 		{
-			stbrp_init_target(&packctx, imagewidth, imageheight, packnodes, numnodes);
-			stbrp_pack_rects(&packctx, packrects, numrects);
-
-			int notpacked = 0;
-			for( int i = 0; i < numrects; ++i )
+			if( i+1 < argc && (strcmp(argv[i+1], "pow2") == 0 || strcmp(argv[i+1], "any") == 0) )
+				options->atlaspow2 = strcmp(argv[i+1], "pow2") == 0;
+			else
 			{
-				notpacked |= packrects[i].was_packed ? 0 : 1;
+				Usage();
+				return 1;
 			}
-
-			if( notpacked )
+		}
+		else if(strcmp(argv[i], "--max-page-size") == 0)
+		{
+			if( i+1 < argc )
+				options->maxpagesize = (int)atol(argv[i+1]);
+			else
 			{
-				delete[] packnodes;
-				if( imagewidth <= imageheight )
-					imagewidth *= 2;
-				else
-					imageheight *= 2;
-				numnodes = imagewidth;
-				packnodes = new stbrp_node[numnodes];
-
-				printf("Didn't fit, increased to %d x %d\n", imagewidth, imageheight);
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--packer") == 0)
+		{
+			if( i+1 < argc )
+			{
+				int found = 0;
+				for( int a = 0; a < (int)(sizeof(g_PackerNames)/sizeof(g_PackerNames[0])); ++a )
+				{
+					if( strcmp(argv[i+1], g_PackerNames[a]) == 0 )
+					{
+						options->packer = (jc_pack_algorithm)a;
+						found = 1;
+					}
+				}
+				if( !found )
+				{
+					fprintf(stderr, "Unknown packer: %s\n", argv[i+1]);
+					Usage();
+					return 1;
+				}
+			}
+			else
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--range") == 0)
+		{
+			if( i+1 >= argc )
+			{
+				Usage();
+				return 1;
+			}
+			if( !ParseRanges(argv[i+1], options->codepoints) )
+			{
+				fprintf(stderr, "Invalid range: %s\n", argv[i+1]);
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--charset-file") == 0)
+		{
+			if( i+1 < argc )
+				options->charsetfile = argv[i+1];
+			else
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--all-glyphs-in-font") == 0)
+		{
+			options->allglyphs = 1;
+		}
+		else if(strcmp(argv[i], "--kerning-pairs") == 0)
+		{
+			options->keeppairs = 1;
+		}
+		else if(strcmp(argv[i], "--atlas") == 0)
+		{
+			if( i+1 >= argc )
+			{
+				Usage();
+				return 1;
+			}
+			options->embedatlas = strcmp(argv[i+1], "png") != 0;
+			int found = !options->embedatlas;
+			for( int a = 0; a < (int)(sizeof(g_AtlasCompressionNames)/sizeof(g_AtlasCompressionNames[0])); ++a )
+			{
+				if( strcmp(argv[i+1], g_AtlasCompressionNames[a]) == 0 )
+				{
+					options->atlascompression = (EFontAtlasCompression)a;
+					found = 1;
+				}
+			}
+			if( !found )
+			{
+				fprintf(stderr, "Unknown atlas format: %s\n", argv[i+1]);
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--atlas-quality") == 0)
+		{
+			int found = 0;
+			for( int a = 0; i+1 < argc && a < (int)(sizeof(g_AtlasQualityNames)/sizeof(g_AtlasQualityNames[0])); ++a )
+			{
+				if( strcmp(argv[i+1], g_AtlasQualityNames[a]) == 0 )
+				{
+					options->atlasquality = (jc_blockcomp_quality)a;
+					found = 1;
+				}
+			}
+			if( !found )
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--texel-format") == 0)
+		{
+			int found = 0;
+			for( int a = 0; i+1 < argc && a < (int)(sizeof(g_TexelFormatNames)/sizeof(g_TexelFormatNames[0])); ++a )
+			{
+				if( strcmp(argv[i+1], g_TexelFormatNames[a]) == 0 )
+				{
+					options->format = (EFontTexelFormat)a;
+					found = 1;
+				}
+			}
+			if( !found )
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--png-level") == 0)
+		{
+			if( i+1 < argc )
+				options->pnglevel = (int)atol(argv[i+1]);
+			if( i+1 >= argc || options->pnglevel < 0 || options->pnglevel > 9 )
+			{
+				fprintf(stderr, "The png level must be 0 to 9\n");
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--png-filter") == 0)
+		{
+			int found = 0;
+			for( int a = 0; i+1 < argc && a < (int)(sizeof(g_PngFilterNames)/sizeof(g_PngFilterNames[0])); ++a )
+			{
+				if( strcmp(argv[i+1], g_PngFilterNames[a]) == 0 )
+				{
+					options->pngfilter = (jc_png_filter)a;
+					found = 1;
+				}
+			}
+			if( !found )
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--channels") == 0)
+		{
+			if( i+1 < argc )
+				options->numchannels = (int)atol(argv[i+1]);
+			else
+			{
+				Usage();
+				return 1;
+			}
+			if( options->numchannels != 1 && options->numchannels != 3 && options->numchannels != 4 )
+			{
+				fprintf(stderr, "The number of channels must be 1, 3 or 4\n");
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--sizes") == 0)
+		{
+			if( i+1 >= argc )
+			{
+				Usage();
+				return 1;
+			}
+			options->sizes.clear();
+			if( !ParseList(argv[i+1], options->sizes) || options->sizes.empty() )
+			{
+				fprintf(stderr, "Invalid sizes: %s\n", argv[i+1]);
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--cache-dir") == 0)
+		{
+			if( i+1 < argc )
+				options->cachedir = argv[i+1];
+			else
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--face") == 0)
+		{
+			if( i+1 < argc )
+				options->faceindex = (int)atol(argv[i+1]);
+			else
+			{
+				Usage();
+				return 1;
+			}
+		}
+		else if(strcmp(argv[i], "--batch") == 0)
+		{
+			if( i+1 < argc )
+				options->batchfile = argv[i+1];
+			else
+			{
+				Usage();
+				return 1;
 			}
 		}
+		else if(strcmp(argv[i], "--numoversampling") == 0)
+		{
+			if( i+1 < argc )
+				options->numoversampling = (int)atol(argv[i+1]);
+			else
+			{
+				Usage();
+				return 1;
+			}
+		}
+	}
+	return 0;
+}
+
+// Checks the options, and resolves the ones that depend on each other. Returns non zero on error
+static int ValidateOptions(SFontOptions* options)
+{
+	if( !options->inputfile )
+	{
+		fprintf(stderr, "You have to specify an input file!\n");
+		Usage();
+		return 1;
+	}
+
+	if( options->fontsize < 1 )
+	{
+		fprintf(stderr, "The font size must be at least 1\n");
+		return 1;
+	}
+	for( size_t i = 0; i < options->sizes.size(); ++i )
+	{
+		if( options->sizes[i] < 1 )
+		{
+			fprintf(stderr, "The font sizes must be at least 1\n");
+			return 1;
+		}
+	}
+
+	// The distance transforms need at least one texel of border around the glyph
+	if( options->radius < 1 )
+	{
+		fprintf(stderr, "The radius must be at least 1\n");
+		return 1;
+	}
+
+	if( (options->fixedwidth > 0) != (options->fixedheight > 0) || options->fixedwidth < 0 || options->fixedheight < 0 )
+	{
+		fprintf(stderr, "A fixed atlas size needs both -w and -h\n");
+		return 1;
+	}
+
+	if( options->maxpagesize < 1 )
+	{
+		fprintf(stderr, "The max page size must be at least 1\n");
+		return 1;
+	}
+
+	// The search only tries powers of two, and the spill over pages are max page size large
+	if( options->atlaspow2 && (options->maxpagesize & (options->maxpagesize - 1)) != 0 )
+	{
+		int maxpagesize = 1;
+		while( maxpagesize <= options->maxpagesize / 2 )
+			maxpagesize *= 2;
+		Info(options, "Rounding the max page size down to a power of two: %d\n", maxpagesize);
+		options->maxpagesize = maxpagesize;
+	}
+
+	if( options->embedatlas && options->numchannels != 1 && (options->atlascompression == FONT_ATLAS_BC4 || options->atlascompression == FONT_ATLAS_EAC_R11) )
+	{
+		fprintf(stderr, "The %s atlas only has a single channel\n", g_AtlasCompressionNames[options->atlascompression]);
+		return 1;
+	}
+
+	if( options->embedatlas && options->format != FONT_FORMAT_R8 && (options->atlascompression == FONT_ATLAS_BC4 || options->atlascompression == FONT_ATLAS_EAC_R11) )
+	{
+		fprintf(stderr, "The %s atlas only has 8 bit texels\n", g_AtlasCompressionNames[options->atlascompression]);
+		return 1;
+	}
+
+	if( strcmp(options->outputfile, "-") == 0 && !options->embedatlas )
+	{
+		fprintf(stderr, "Writing to stdout needs the atlas in the .font file, use --atlas raw|lz4|bc4|eac with -o -\n");
+		return 1;
+	}
+
+	if( strcmp(options->outputfile, "-") == 0 && !options->sizes.empty() )
+	{
+		fprintf(stderr, "--sizes writes one file per size, and cannot write to stdout\n");
+		return 1;
+	}
+
+	if( !options->embedatlas && options->format == FONT_FORMAT_R16F )
+	{
+		fprintf(stderr, "Png files can't have float texels, use --atlas raw or --atlas lz4 for r16f\n");
+		return 1;
+	}
 
-		int imagesize = imagewidth * imageheight;
-		unsigned char* imageout = (unsigned char*)malloc(imagesize);
-		memset(imageout, 0, imagesize);
+	if( options->numchannels > 1 && options->algorithm != SDF_ALGORITHM_VECTOR )
+	{
+		Info(options, "Multi channel fields are calculated from the outlines, using the vector algorithm\n");
+		options->algorithm = SDF_ALGORITHM_VECTOR;
+	}
 
-		float fontscale = stbtt_ScaleForPixelHeight(&f, fontsize*numoversampling);
-		int _lineascent, _linedescend, _linegap;
-		stbtt_GetFontVMetrics(&f, &_lineascent, &_linedescend, &_linegap);
-		
-		std::vector<SFontGlyph> outglyphs;
-		std::map<int, int> glyph_to_codepoint;
+	if( options->algorithm == SDF_ALGORITHM_VECTOR && options->numoversampling != 1 )
+	{
+		Info(options, "The vector algorithm doesn't need oversampling, ignoring --numoversampling %d\n", options->numoversampling);
+		options->numoversampling = 1;
+	}
 
-		uint64_t totaltime = 0;
-		uint64_t totaltimesdf = 0;
+	if( options->numthreads <= 0 )
+	{
+		options->numthreads = (int)std::thread::hardware_concurrency();
+		if( options->numthreads <= 0 )
+			options->numthreads = 1;
+	}
+	return 0;
+}
 
-		uint32_t maxglyphsize = 0;
-		for( int i = 0; i < numrects; ++i)
+/** Reads the batch manifest: one font per line, using the same options as the command line, e.g.
+ *		-i fonts/NotoSansCJK.ttc --face 2 -s 48 -r 6 --charset-file jp.txt -o out/jp48.font
+ * The options given on the command line are the defaults for each line. The --range options of a line replace the default ranges.
+ * Empty lines, and lines starting with '#' are skipped. Arguments with spaces can be put within double quotes.
+ * The strings are kept in 'storage', and stay valid as long as it does.
+ */
+static int ReadBatchFile(const char* path, const SFontOptions* defaults, std::vector<SFontOptions>& jobs, std::vector<std::vector<char> >& storage)
+{
+	FILE* file = fopen(path, "rb");
+	if( !file )
+	{
+		fprintf(stderr, "Failed to read %s\n", path);
+		return 1;
+	}
+
+	// Read all lines first, since the jobs point into the storage
+	char* line = 0;
+	size_t capacity = 0;
+	ssize_t length;
+	while( (length = getline(&line, &capacity, file)) >= 0 )
+		storage.push_back(std::vector<char>(line, line + length + 1));
+	free(line);
+	fclose(file);
+
+	for( size_t l = 0; l < storage.size(); ++l )
+	{
+		char* s = &storage[l][0];
+
+		std::vector<const char*> args;
+		args.push_back(path);	// In place of the program name
+		while( *s )
 		{
-			maxglyphsize = packrects[i].w > maxglyphsize ? packrects[i].w : maxglyphsize;
-			maxglyphsize = packrects[i].h > maxglyphsize ? packrects[i].h : maxglyphsize;
+			while( *s == ' ' || *s == '\t' || *s == '\r' || *s == '\n' )
+				*s++ = 0;
+			if( !*s || (*s == '#' && args.size() == 1) )
+				break;
+			char quote = *s == '"';
+			if( quote )
+				++s;
+			args.push_back(s);
+			while( *s && (quote ? *s != '"' : (*s != ' ' && *s != '\t' && *s != '\r' && *s != '\n')) )
+				++s;
+			if( *s )
+				*s++ = 0;
 		}
-		maxglyphsize += (padding[0] > padding[1] ? padding[0] : padding[1]) * 2 + radius;
-		maxglyphsize *= numoversampling;
-		
-		unsigned char* sdftemp = (unsigned char*)malloc(maxglyphsize*maxglyphsize*sizeof(float)*3);
-
-		unsigned char* bitmap = new unsigned char[maxglyphsize*maxglyphsize];
-		unsigned char* bitmapsdf = new unsigned char[maxglyphsize*maxglyphsize];
+		if( args.size() == 1 )
+			continue;
 
-		for( int i = 0; i < numrects; ++i)
+		SFontOptions options = *defaults;
+		options.codepoints.clear();
+		int error = ParseOptions((int)args.size(), &args[0], &options);
+		if( !error && options.codepoints.empty() )
+			options.codepoints = defaults->codepoints;
+		if( error || ValidateOptions(&options) )
+		{
+			fprintf(stderr, "%s:%d: Invalid options\n", path, (int)l + 1);
+			return 1;
+		}
+		if( options.batchfile != defaults->batchfile )
+		{
+			fprintf(stderr, "%s:%d: Batch files cannot be nested\n", path, (int)l + 1);
+			return 1;
+		}
+		if( strcmp(options.outputfile, "-") == 0 )
 		{
-			int codepoint = packrects[i].id;
-			int glyph = stbtt_FindGlyphIndex(&f, codepoint);
-			glyph_to_codepoint.insert( std::make_pair(glyph, codepoint) );
+			fprintf(stderr, "%s:%d: Batch jobs cannot write to stdout\n", path, (int)l + 1);
+			return 1;
+		}
+		jobs.push_back(options);
+	}
+	return 0;
+}
 
-			uint32_t bitmapwidth  	= packrects[i].w * numoversampling;
-			uint32_t bitmapheight	= packrects[i].h * numoversampling;
-			uint32_t bitmapsize 	= bitmapwidth * bitmapheight;
-			memset(bitmap, 0, bitmapsize);
+// Gathers the code points from the options, and removes the ones the font doesn't have. Returns non zero on error
+static int ResolveCodepoints(const SFontOptions* options, std::vector<int>& codepoints)
+{
+	codepoints = options->codepoints;
+	if( options->charsetfile && !ReadCharsetFile(options->charsetfile, codepoints) )
+	{
+		fprintf(stderr, "Failed to read %s\n", options->charsetfile);
+		return 1;
+	}
+	if( options->allglyphs )
+		AddAllGlyphsInFont(options->font, codepoints);
+	if( codepoints.empty() )
+		ParseRanges("0x20-0x7e", codepoints);
 
-			// Since the bitmap is larger than the actual glyph, we need to offset the start
-			uint32_t bitmapoffset 	= ((padding[1] + radius) * numoversampling)  * bitmapwidth + (padding[0] + radius) * numoversampling;
-			uint32_t glyphwidth   	= bitmapwidth - padding[0] - padding[2] - radius*2;
-			uint32_t glyphheight	= bitmapheight - padding[1] - padding[3] - radius*2;
-			uint64_t ts = gettime();
-			stbtt_MakeGlyphBitmap(&f, bitmap + bitmapoffset, glyphwidth, glyphheight, bitmapwidth, scale, scale, glyph);
+	std::sort(codepoints.begin(), codepoints.end());
+	codepoints.erase(std::unique(codepoints.begin(), codepoints.end()), codepoints.end());
 
-			uint64_t te = gettime();
-			totaltime += te - ts;
+	// The code points the font doesn't have would all get the "missing" glyph
+	int nummissing = 0;
+	for( size_t i = 0; i < codepoints.size(); ++i )
+	{
+		if( stbtt_FindGlyphIndex(options->font, codepoints[i]) == 0 )
+			++nummissing;
+		else
+			codepoints[i - nummissing] = codepoints[i];
+	}
+	codepoints.resize(codepoints.size() - nummissing);
+	if( nummissing )
+		Info(options, "Skipped %d code point(s) that are missing in the font\n", nummissing);
+	if( codepoints.empty() )
+	{
+		fprintf(stderr, "None of the code points are in the font %s\n", options->inputfile);
+		return 1;
+	}
+	return 0;
+}
 
-			assert(maxglyphsize >= bitmapwidth);
-			assert(maxglyphsize >= bitmapheight);
+static void DestroyOutlines(SFontOutlines* outlines)
+{
+	for( size_t i = 0; i < outlines->glyphs.size(); ++i )
+		sdf_glyph_outline_free(&outlines->glyphs[i]);
+	outlines->glyphs.clear();
+	outlines->codepoints.clear();
+}
 
-			/*
-			int bmsize = bitmapwidth*bitmapheight;
-			short* distx = (short*)malloc(bmsize*sizeof(short));
-			short* disty = (short*)malloc(bmsize*sizeof(short));
-			double* dist = (double*)malloc(bmsize*sizeof(double));
-			double* gx = (double*)malloc(bmsize*sizeof(double));
-			double* gy = (double*)malloc(bmsize*sizeof(double));
-			double* img = (double*)malloc(bmsize*sizeof(double));
-			*/
+/** Reads the outlines of all the glyphs.
+ * The contours are flattened for the largest scale they'll be rasterized at, which is fine enough for the smaller ones too.
+ * The vector algorithm uses the curves instead.
+ */
+static int CreateOutlines(const SFontOptions* options, float maxscale, SFontOutlines* outlines)
+{
+	if( ResolveCodepoints(options, outlines->codepoints) )
+		return 1;
 
-			ts = gettime();
-			//sdfBuildDistanceFieldNoAlloc(bitmapsdf, bitmapwidth, radius*numoversampling, bitmap, bitmapwidth, bitmapheight, bitmapwidth, sdftemp);
-			jc_sdf_dr_eedtaa3(bitmap, bitmapwidth, bitmapheight, bitmapsdf, bitmapwidth, radius*numoversampling);
+	sdf_glyph_params params;
+	memset(&params, 0, sizeof(params));
+	params.algorithm	= options->algorithm;
+	params.numchannels	= options->numchannels;
+	params.format		= (jc_sdf_format)options->format;
+
+	const stbtt_fontinfo* f = options->font;
+	outlines->flattenscale = options->algorithm == SDF_ALGORITHM_VECTOR ? 0.0f : maxscale;
+	outlines->glyphs.resize(outlines->codepoints.size());
+	for( size_t i = 0; i < outlines->codepoints.size(); ++i )
+		sdf_glyph_outline_create(f, stbtt_FindGlyphIndex(f, outlines->codepoints[i]), &params, maxscale, &outlines->glyphs[i]);
+	return 0;
+}
 
-			/*
-			for( int xxx = 0; xxx < bmsize; ++xxx )
-			{
-				img[xxx] = bitmap[xxx] / 255.0;
-			}
-			computegradient(img, bitmapwidth, bitmapheight, gx, gy);
-			edtaa4(img, gx, gy, bitmapwidth, bitmapheight, distx, disty, dist);
-			postprocess(img, gx, gy, bitmapwidth, bitmapheight, distx, disty, dist);
-			for( int xxx = 0; xxx < bmsize; ++xxx )
-			{
-				double v = dist[xxx] / radius;
-				if( v > 1.0 )
-					v = 1.0;
-				if( bitmap[xxx] == 255 )
-					v = -v;
-				bitmapsdf[xxx] = (uint8_t)((0.5 - 0.5 * v) * 255.0);
-			}
-			 */
+// The kerning of each glyph pair, and the last GPOS lookup that added to it
+struct SGlyphKerning
+{
+	int		lookup;
+	int		kerning;
+};
 
-			te = gettime();
-			totaltimesdf += te-ts;
-			totaltime += te-ts;
+typedef std::map<std::pair<int, int>, SGlyphKerning> TGlyphKernings;
 
-			for( int o = 1; o < numoversampling; ++o )
-				Minify2x(bitmapsdf, bitmapwidth, bitmapheight);
+// Within a lookup, the first subtable that has the pair wins, also with a zero kerning. Different lookups add up
+static void AddGposKerning(void* userdata, int lookup, int glyph1, int glyph2, int xadvance)
+{
+	TGlyphKernings& kernings = *(TGlyphKernings*)userdata;
+	std::pair<TGlyphKernings::iterator, bool> it = kernings.insert(std::make_pair(std::make_pair(glyph1, glyph2), SGlyphKerning()));
+	SGlyphKerning& k = it.first->second;
+	if( it.second )
+	{
+		k.lookup = lookup;
+		k.kerning = xadvance;
+	}
+	else if( k.lookup != lookup )
+	{
+		k.lookup = lookup;
+		k.kerning += xadvance;
+	}
+}
 
-			CopyBitmap(bitmapsdf, bitmapwidth/numoversampling, bitmapheight/numoversampling, imageout, imagewidth, imageheight, packrects[i].x, packrects[i].y);
+// Reads the kerning of the chosen glyphs from the GPOS table, or the legacy kern table if the font has no GPOS kerning
+static void ReadGlyphKernings(const SFontOptions* options, const stbtt_fontinfo* f, const std::vector<std::pair<int, int> >& glyph_to_codepoint, TGlyphKernings& kernings)
+{
+	std::vector<uint8_t> glyphmask(f->numGlyphs > 0 ? f->numGlyphs : 1, 0);
+	for( size_t i = 0; i < glyph_to_codepoint.size(); ++i )
+	{
+		if( glyph_to_codepoint[i].first < f->numGlyphs )
+			glyphmask[glyph_to_codepoint[i].first] = 1;
+	}
 
-			int advance;
-			int bearingx;
-			stbtt_GetGlyphHMetrics(&f, glyph, &advance, &bearingx);
+	int numgpospairs = jc_gpos_pairs(f->data, f->fontstart, &glyphmask[0], f->numGlyphs, AddGposKerning, &kernings);
+	if( numgpospairs < 0 )
+	{
+		Info(options, "The GPOS table is malformed, using the kern table\n");
+		kernings.clear();
+	}
+	// The pairs with a zero kerning only matter while reading the lookups
+	for( TGlyphKernings::const_iterator it = kernings.begin(); it != kernings.end(); ++it )
+	{
+		if( it->second.kerning )
+			return;
+	}
+	kernings.clear();
 
-			int x1, y1, x2, y2;
-			stbtt_GetGlyphBitmapBox(&f, glyph, fontscale, fontscale, &x1, &y1, &x2, &y2);
+	int numpairkernings = stbtt_GetNumGlyphKernings(f);
+	for( int i = 0; i < numpairkernings; ++i )
+	{
+		int glyph1, glyph2, kerning;
+		stbtt_GetGlyphKerning(f, i, &glyph1, &glyph2, &kerning);
+		if( glyph1 < f->numGlyphs && glyph2 < f->numGlyphs && glyphmask[glyph1] && glyphmask[glyph2] )
+			AddGposKerning(&kernings, 0, glyph1, glyph2, kerning);
+	}
+}
 
-			SFontGlyph outglyph;
+static int GenerateFont(const SFontOptions* options)
+{
+	const stbtt_fontinfo* f		= options->font;
+	const char* inputfile		= options->inputfile;
+	const char* outputfile		= options->outputfile;
+	int fontsize				= options->fontsize;
+	int radius					= options->radius;
+	const int* padding			= options->padding;
+	int numoversampling			= options->numoversampling;
+	int numthreads				= options->numthreads;
+	sdf_algorithm algorithm		= options->algorithm;
+	int numchannels				= options->numchannels;
+	EFontTexelFormat format		= options->format;
+	jc_pack_algorithm packer	= options->packer;
+	int fixedwidth				= options->fixedwidth;
+	int fixedheight				= options->fixedheight;
+	int atlaspow2				= options->atlaspow2;
+	int maxpagesize				= options->maxpagesize;
+
+	Info(options, "Font is %s, chosen height is %d\n", inputfile, fontsize);
+	Info(options, "Outline radius is %d\n", radius);
+	Info(options, "Distance transform is %s\n", g_AlgorithmNames[algorithm]);
+	Info(options, "Distance sweep uses %s\n", JC_SDF_SIMD_NAME);
+	Info(options, "Texel format is %s\n", g_TexelFormatNames[format]);
+
+	float scale = stbtt_ScaleForPixelHeight(f, fontsize * numoversampling);
+
+	sdf_glyph_params params;
+	params.scale			= scale;
+	params.radius			= radius;
+	memcpy(params.padding, padding, sizeof(params.padding));
+	params.numoversampling	= numoversampling;
+	params.algorithm		= algorithm;
+	params.numchannels		= numchannels;
+	params.format			= (jc_sdf_format)format;
+
+	SFontOutlines localoutlines;
+	const SFontOutlines* outlines = options->outlines;
+	if( !outlines )
+	{
+		if( CreateOutlines(options, scale, &localoutlines) )
+			return 1;
+		outlines = &localoutlines;
+	}
+	const std::vector<int>& codepoints = outlines->codepoints;
+	Info(options, "Number of glyphs: %d\n", (int)codepoints.size());
+
+	int numrects = (int)codepoints.size();
+	jc_pack_rect* packrects = new jc_pack_rect[numrects ? numrects : 1];
+	int area = 0;
+	for( int c = 0; c < numrects; ++c )
+	{
+		int codepoint = codepoints[c];
+		packrects[c].id = codepoint;
+		int glyph = outlines->glyphs[c].glyph;
 
-			outglyph.codepoint = codepoint;
-			outglyph.box[0]	= packrects[i].x;
-			outglyph.box[1]	= packrects[i].y;
-			outglyph.box[2]	= (packrects[i].x + packrects[i].w);
-			outglyph.box[3]	= (packrects[i].y + packrects[i].h);
-			outglyph.offset[0]	= 0;//padding[0] + radius;
-			outglyph.offset[1]	= y2 / numoversampling;//padding[1] + radius + -y1 / numoversampling;// (lineascent - packrects[i].h);
-			outglyph.advance	= (advance * scale) / numoversampling;
-			outglyph.bearing_x	= (bearingx * scale) / numoversampling;
-			outglyphs.push_back(outglyph);
+		sdf_glyph_tile_size(f, glyph, &params, &packrects[c].w, &packrects[c].h);
 
-			/*if( codepoint == 'T' || codepoint == 'a' || codepoint == 'e')
-			{
-				printf("%c  codepoint = %d\n", (char)codepoint, codepoint);
-				printf("  box = t,l: %d, %d  b,r: %d, %d\n", outglyph.box[0], outglyph.box[1], outglyph.box[2], outglyph.box[3]);
-				printf("  offset = %f, %f\n", outglyph.offset[0], outglyph.offset[1]);
-				printf("  advance = %f\n", outglyph.advance);
-				printf("  bearing_x = %f\n", outglyph.bearing_x);
+		area += packrects[c].w * packrects[c].h;
+	}
 
-				printf("  bbox: %d, %d   %d, %d\n", x1, y1, x2, y2);
-				printf("\n");
-			}*/
+	Info(options, "area: %d\n", area);
+
+	int imagewidth = fixedwidth;
+	int imageheight = fixedheight;
+	int numattempts = 0;
+	int numpages = 1;
+	if( !FindAtlasSize(packer, packrects, numrects, atlaspow2, maxpagesize, &imagewidth, &imageheight, &numattempts) )
+	{
+		// Spill over into more pages, each one as large as allowed
+		imagewidth = fixedwidth > 0 ? fixedwidth : maxpagesize;
+		imageheight = fixedheight > 0 ? fixedheight : maxpagesize;
+		numpages = jc_pack_rects_pages(packer, imagewidth, imageheight, packrects, numrects, 0);
+		if( !numpages || numpages > 0xFFFF )
+		{
+			int notpacked = 0;
+			for( int i = 0; i < numrects; ++i )
+				notpacked += packrects[i].was_packed ? 0 : 1;
+			fprintf(stderr, "Failed to pack the glyphs: %d of %d glyphs don't fit in %d x %d\n", notpacked, numrects, imagewidth, imageheight);
+			delete[] packrects;
+			DestroyOutlines(&localoutlines);
+			return 1;
 		}
+	}
+	Info(options, "Atlas size: %d x %d x %d page(s) (%s, %d pack attempts)\n", imagewidth, imageheight, numpages, atlaspow2 ? "pow2" : "any", numattempts);
+	Info(options, "Packing efficiency (%s): %.1f%%\n", g_PackerNames[packer], jc_pack_efficiency(imagewidth, imageheight * numpages, packrects, numrects) * 100.0f);
+
+	size_t imagesize = (size_t)imagewidth * imageheight * numchannels * FontTexelFormatSize(format);
+	std::vector<unsigned char*> pages(numpages);
+	for( int p = 0; p < numpages; ++p )
+	{
+		pages[p] = (unsigned char*)malloc(imagesize);
+		memset(pages[p], 0, imagesize);
+	}
+
+	float fontscale = stbtt_ScaleForPixelHeight(f, fontsize*numoversampling);
+	int _lineascent, _linedescend, _linegap;
+	stbtt_GetFontVMetrics(f, &_lineascent, &_linedescend, &_linegap);
+	
+	std::vector<SFontGlyph> outglyphs(numrects);
+	// Sorted by glyph, since several code points may share a glyph
+	std::vector<std::pair<int, int> > glyph_to_codepoint(numrects);
+	for( int i = 0; i < numrects; ++i)
+	{
+		glyph_to_codepoint[i] = std::make_pair(outlines->glyphs[i].glyph, packrects[i].id);
+	}
+	std::sort(glyph_to_codepoint.begin(), glyph_to_codepoint.end());
+
+	uint32_t maxglyphsize = 0;
+	for( int i = 0; i < numrects; ++i)
+	{
+		maxglyphsize = (uint32_t)packrects[i].w > maxglyphsize ? (uint32_t)packrects[i].w : maxglyphsize;
+		maxglyphsize = (uint32_t)packrects[i].h > maxglyphsize ? (uint32_t)packrects[i].h : maxglyphsize;
+	}
+	maxglyphsize += (padding[0] > padding[1] ? padding[0] : padding[1]) * 2 + radius;
+	maxglyphsize *= numoversampling;
+
+	if( numthreads > numrects )
+		numthreads = numrects > 0 ? numrects : 1;
+
+	SGlyphCache cache;
+	if( options->cachedir )
+	{
+		mkdir(options->cachedir, 0755);
+
+		memset(&cache.key, 0, sizeof(cache.key));
+		cache.dir					= options->cachedir;
+		cache.key.fonthash			= options->fonthash;
+		cache.key.faceindex			= options->faceindex;
+		cache.key.fontsize			= fontsize;
+		cache.key.radius			= radius;
+		cache.key.numoversampling	= numoversampling;
+		memcpy(cache.key.padding, padding, sizeof(cache.key.padding));
+		cache.key.algorithm			= algorithm;
+		cache.key.numchannels		= numchannels;
+		cache.key.flattenscale		= outlines->flattenscale;
+		cache.key.version			= GLYPH_CACHE_VERSION;
+		cache.key.format			= format;
+		cache.numhits				= 0;
+		cache.nummisses				= 0;
+	}
 
-		delete[] bitmap;
-		delete[] bitmapsdf;
+	SGlyphContext ctx;
+	ctx.font			= f;
+	ctx.cache			= options->cachedir ? &cache : 0;
+	ctx.outlines		= &outlines->glyphs[0];
+	ctx.packrects		= packrects;
+	ctx.numrects		= numrects;
+	ctx.params			= params;
+	ctx.maxglyphsize	= maxglyphsize;
+	ctx.pages			= &pages[0];
+	ctx.imagewidth		= imagewidth;
+	ctx.imageheight		= imageheight;
+	ctx.outglyphs		= &outglyphs[0];
+	ctx.next			= 0;
+
+	std::vector<SGlyphScratch> scratch(numthreads);
+	for( int t = 0; t < numthreads; ++t )
+		CreateGlyphScratch(&scratch[t], maxglyphsize);
+
+	uint64_t tstart = gettime();
+
+	std::vector<std::thread> workers;
+	for( int t = 1; t < numthreads; ++t )
+		workers.push_back( std::thread(GlyphWorker, &ctx, &scratch[t]) );
+	GlyphWorker(&ctx, &scratch[0]);
+	for( size_t t = 0; t < workers.size(); ++t )
+		workers[t].join();
+
+	uint64_t totalwalltime = gettime() - tstart;
+
+	uint64_t totaltime = 0;
+	uint64_t totaltimesdf = 0;
+	for( int t = 0; t < numthreads; ++t )
+	{
+		totaltime += scratch[t].totaltime;
+		totaltimesdf += scratch[t].totaltimesdf;
+		DestroyGlyphScratch(&scratch[t]);
+	}
 
-		printf("Max bitmap size: %d, %d\n", maxglyphsize, maxglyphsize);
-		printf("Average %llu us\n", totaltime/numrects);
-		printf("Average sdf %llu us\n", totaltimesdf/numrects);
-		printf("Total %llu us for %d glyphs\n", totaltime, numrects);
-		printf("Total sdf %llu us\n", totaltimesdf);
+	Info(options, "Max bitmap size: %u, %u\n", maxglyphsize, maxglyphsize);
+	Info(options, "Average %llu us\n", (unsigned long long)(totaltime/numrects));
+	Info(options, "Average sdf %llu us\n", (unsigned long long)(totaltimesdf/numrects));
+	Info(options, "Total %llu us for %d glyphs\n", (unsigned long long)totaltime, numrects);
+	Info(options, "Total sdf %llu us\n", (unsigned long long)totaltimesdf);
+	Info(options, "Wall time %llu us using %d thread(s)\n", (unsigned long long)totalwalltime, numthreads);
+	if( options->cachedir )
+		Info(options, "Glyph cache: %d hits, %d misses\n", (int)cache.numhits, (int)cache.nummisses);
 
 
+	for( int p = 0; p < numpages && !options->embedatlas; ++p )
+	{
 		char path[512];
-		sprintf(path, "%s.png", outputfile);
-		stbi_write_png(path, imagewidth, imageheight, 1, imageout, 0);
-		printf("Wrote %s\n", path);
+		if( numpages == 1 )
+			sprintf(path, "%s.png", outputfile);
+		else
+			sprintf(path, "%s.%d.png", outputfile, p);
+		if( WritePng(path, imagewidth, imageheight, numchannels, FontTexelFormatSize(format) * 8, pages[p], options->pnglevel, options->pngfilter, numthreads) )
+		{
+			fprintf(stderr, "Failed to write %s\n", path);
+			for( int i = 0; i < numpages; ++i )
+				free(pages[i]);
+			delete[] packrects;
+			DestroyOutlines(&localoutlines);
+			return 1;
+		}
+		Info(options, "Wrote %s\n", path);
+	}
+
+	TGlyphKernings glyphkernings;
+	ReadGlyphKernings(options, f, glyph_to_codepoint, glyphkernings);
 
-		free(imageout);
+	std::vector<SFontPairKerning> pairkernings;
+	for( TGlyphKernings::const_iterator gk = glyphkernings.begin(); gk != glyphkernings.end(); ++gk )
+	{
+		int glyph1 = gk->first.first;
+		int glyph2 = gk->first.second;
+		int kerning = gk->second.kerning;
+		if( !kerning )
+			continue;
 
-		std::vector<SFontPairKerning> pairkernings;
-		int numpairkernings = stbtt_GetNumGlyphKernings(&f);
-		for( int i = 0; i < numpairkernings; ++i )
+		// Only the glyphs in the chosen set are in the table
+		typedef std::vector<std::pair<int, int> >::const_iterator TIter;
+		std::pair<TIter, TIter> range1 = std::equal_range(glyph_to_codepoint.begin(), glyph_to_codepoint.end(), std::make_pair(glyph1, 0), GlyphLess);
+		if( range1.first == range1.second )
+			continue;
+		std::pair<TIter, TIter> range2 = std::equal_range(glyph_to_codepoint.begin(), glyph_to_codepoint.end(), std::make_pair(glyph2, 0), GlyphLess);
+
+		for( TIter it1 = range1.first; it1 != range1.second; ++it1 )
 		{
-			int glyph1, glyph2, kerning;
-			stbtt_GetGlyphKerning(&f, i, &glyph1, &glyph2, &kerning);
+			for( TIter it2 = range2.first; it2 != range2.second; ++it2 )
+			{
+				SFontPairKerning pairkerning;
+				pairkerning.key		= (uint64_t(it2->second) << 32) | it1->second;
+				pairkerning.kerning = (kerning * fontscale) / numoversampling;
+				pairkernings.push_back( pairkerning );
 
-			std::map<int, int>::const_iterator it1 = glyph_to_codepoint.find(glyph1);
-			std::map<int, int>::const_iterator it2 = glyph_to_codepoint.find(glyph2);
-			if( it1 == glyph_to_codepoint.end() || it2 == glyph_to_codepoint.end() )
-				continue;
+				//printf("pk %c %c   %f 0x%016llx (%d  %d),  (%d  %d)\n", it1->second, it2->second, kerning * fontscale, pairkerning.key, it1->second, it2->second, glyph1, glyph2);
+			}
+		}
+	}
+	
+	Info(options, "num pair kernings: %llu\n", (unsigned long long)pairkernings.size());
+
+	int failed = WriteFontInfo(f, outputfile, imagewidth, imageheight, numpages, fontsize, radius, numchannels, format, outglyphs, pairkernings, options->keeppairs,
+								options->embedatlas ? &pages : 0, options->atlascompression, options->atlasquality);
+	for( int p = 0; p < numpages; ++p )
+		free(pages[p]);
+	if( failed )
+	{
+		fprintf(stderr, "Failed to write %s\n", outputfile);
+		delete[] packrects;
+		DestroyOutlines(&localoutlines);
+		return 1;
+	}
+	if( options->embedatlas )
+		Info(options, "Wrote %s (%s atlas)\n", outputfile, g_AtlasCompressionNames[options->atlascompression]);
+	else
+		Info(options, "Wrote %s\n", outputfile);
 
-			if( it1->second < ranges[0] || it1->second >= ranges[1] )
-				continue;
-			if( it2->second < ranges[0] || it2->second >= ranges[1] )
+	delete[] packrects;
+	DestroyOutlines(&localoutlines);
+	return 0;
+}
+
+// The fonts are loaded once, and shared by all jobs using them
+struct SLoadedFont
+{
+	std::string		path;
+	int				faceindex;
+	int				ownsfile;	// Other faces in the same .ttc share the file
+	uint64_t		filehash;	// Only calculated when the glyph cache is used
+	SFontFile		file;
+	stbtt_fontinfo	info;
+};
+
+static int LoadFonts(std::vector<SFontOptions>& jobs, std::vector<SLoadedFont*>& fonts)
+{
+	for( size_t j = 0; j < jobs.size(); ++j )
+	{
+		SFontOptions& job = jobs[j];
+		SLoadedFont* font = 0;
+		const SFontFile* file = 0;
+		for( size_t i = 0; i < fonts.size() && !font; ++i )
+		{
+			if( fonts[i]->path != job.inputfile )
 				continue;
-			
-			SFontPairKerning pairkerning;
-			pairkerning.key		= (uint64_t(it2->second) << 32) | it1->second;
-			pairkerning.kerning = (kerning * fontscale) / numoversampling;
-			pairkernings.push_back( pairkerning );
+			file = &fonts[i]->file;
+			if( fonts[i]->faceindex == job.faceindex )
+				font = fonts[i];
+		}
+		if( !font )
+		{
+			font = new SLoadedFont;
+			font->path = job.inputfile;
+			font->faceindex = job.faceindex;
+			font->ownsfile = file == 0;
+			font->filehash = 0;
+			if( file )
+				font->file = *file;
+			else if( !OpenFontFile(job.inputfile, &font->file) )
+			{
+				fprintf(stderr, "Failed to read %s\n", job.inputfile);
+				delete font;
+				return 1;
+			}
+			fonts.push_back(font);
 
-			//printf("pk %c %c   %f 0x%016llx (%d  %d),  (%d  %d)\n", it1->second, it2->second, kerning * fontscale, pairkerning.key, it1->second, it2->second, glyph1, glyph2);
+			int offset = stbtt_GetFontOffsetForIndex(font->file.data, job.faceindex);
+			if( offset < 0 || !stbtt_InitFont(&font->info, font->file.data, offset) )
+			{
+				fprintf(stderr, "Failed to init font %s (face %d)\n", job.inputfile, job.faceindex);
+				return 1;
+			}
 		}
-		
-		printf("num pair kernings: %llu\n", (uint64_t)pairkernings.size());
+		job.font = &font->info;
+		if( job.cachedir && !font->filehash )
+			font->filehash = HashBytes(font->file.data, font->file.size, 0xCBF29CE484222325ULL);
+		job.fonthash = font->filehash;
+	}
+	return 0;
+}
 
-		WriteFontInfo(&f, outputfile, imagewidth, imageheight, fontsize, radius, outglyphs, pairkernings);
-		printf("Wrote %s\n", outputfile);
+static void UnloadFonts(std::vector<SLoadedFont*>& fonts)
+{
+	for( size_t i = 0; i < fonts.size(); ++i )
+	{
+		if( fonts[i]->ownsfile )
+			CloseFontFile(&fonts[i]->file);
+		delete fonts[i];
 	}
+	fonts.clear();
+}
 
+// "out/font.font" -> "out/font_16.font"
+static std::string SizedPath(const char* path, int size)
+{
+	std::string p(path);
+	size_t dot = p.find_last_of('.');
+	size_t slash = p.find_last_of("/\\");
+	if( dot == std::string::npos || (slash != std::string::npos && dot < slash) )
+		dot = p.size();
+	char suffix[32];
+	sprintf(suffix, "_%d", size);
+	return p.substr(0, dot) + suffix + p.substr(dot);
+}
+
+/** Replaces the jobs that have several sizes, with one job per size.
+ * The outlines are read once per job, and shared by its sizes.
+ */
+static int ExpandSizes(std::vector<SFontOptions>& jobs, std::vector<SFontOutlines*>& outlines, std::list<std::string>& paths)
+{
+	std::vector<SFontOptions> expanded;
+	for( size_t j = 0; j < jobs.size(); ++j )
+	{
+		const SFontOptions& job = jobs[j];
+		if( job.sizes.empty() )
+		{
+			expanded.push_back(job);
+			continue;
+		}
+
+		int maxsize = *std::max_element(job.sizes.begin(), job.sizes.end());
+		SFontOutlines* shared = new SFontOutlines;
+		outlines.push_back(shared);
+		if( CreateOutlines(&job, stbtt_ScaleForPixelHeight(job.font, maxsize * job.numoversampling), shared) )
+			return 1;
+
+		for( size_t i = 0; i < job.sizes.size(); ++i )
+		{
+			paths.push_back(SizedPath(job.outputfile, job.sizes[i]));
+			SFontOptions sized = job;
+			sized.sizes.clear();
+			sized.fontsize = job.sizes[i];
+			sized.outputfile = paths.back().c_str();
+			sized.outlines = shared;
+			expanded.push_back(sized);
+		}
+	}
+	jobs.swap(expanded);
 	return 0;
 }
+
+static void DestroySharedOutlines(std::vector<SFontOutlines*>& outlines)
+{
+	for( size_t i = 0; i < outlines.size(); ++i )
+	{
+		DestroyOutlines(outlines[i]);
+		delete outlines[i];
+	}
+	outlines.clear();
+}
+
+struct SBatchContext
+{
+	const std::vector<SFontOptions>*	jobs;
+	std::atomic<int>					next;		// The next job to process
+	std::atomic<int>					numfailed;
+};
+
+static void BatchWorker(SBatchContext* ctx)
+{
+	int i;
+	while( (i = ctx->next++) < (int)ctx->jobs->size() )
+	{
+		const SFontOptions& job = (*ctx->jobs)[i];
+		uint64_t ts = gettime();
+		if( GenerateFont(&job) )
+		{
+			fprintf(stderr, "Failed to generate %s\n", job.outputfile);
+			ctx->numfailed++;
+		}
+		else
+			printf("Wrote %s (%s, size %d) in %llu ms\n", job.outputfile, job.inputfile, job.fontsize, (unsigned long long)((gettime() - ts) / 1000));
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	SFontOptions options;
+	InitOptions(&options);
+	if( ParseOptions(argc, argv, &options) )
+		return 1;
+
+	std::vector<SFontOptions> jobs;
+	std::vector<std::vector<char> > batchstorage;
+	int numjobthreads = 1;
+	if( options.batchfile )
+	{
+		// -j sets the number of concurrent jobs, and each job processes its own glyphs (unless -j is given on its line)
+		numjobthreads = options.numthreads > 0 ? options.numthreads : (int)std::thread::hardware_concurrency();
+		numjobthreads = numjobthreads > 0 ? numjobthreads : 1;
+		options.numthreads = 1;
+		options.verbose = 0;
+		if( ReadBatchFile(options.batchfile, &options, jobs, batchstorage) )
+			return 1;
+	}
+	else
+	{
+		if( ValidateOptions(&options) )
+			return 1;
+		jobs.push_back(options);
+	}
+
+	std::vector<SLoadedFont*> fonts;
+	if( LoadFonts(jobs, fonts) )
+	{
+		UnloadFonts(fonts);
+		return 1;
+	}
+
+	std::vector<SFontOutlines*> outlines;
+	std::list<std::string> sizedpaths;
+	if( ExpandSizes(jobs, outlines, sizedpaths) )
+	{
+		DestroySharedOutlines(outlines);
+		UnloadFonts(fonts);
+		return 1;
+	}
+
+	int result = 0;
+	if( !options.batchfile && jobs.size() == 1 )
+	{
+		result = GenerateFont(&jobs[0]);
+	}
+	else
+	{
+		uint64_t tstart = gettime();
+
+		SBatchContext ctx;
+		ctx.jobs		= &jobs;
+		ctx.next		= 0;
+		ctx.numfailed	= 0;
+
+		if( numjobthreads > (int)jobs.size() )
+			numjobthreads = jobs.size() > 0 ? (int)jobs.size() : 1;
+
+		std::vector<std::thread> workers;
+		for( int t = 1; t < numjobthreads; ++t )
+			workers.push_back( std::thread(BatchWorker, &ctx) );
+		BatchWorker(&ctx);
+		for( size_t t = 0; t < workers.size(); ++t )
+			workers[t].join();
+
+		printf("Generated %d of %d fonts from %d font(s) in %llu ms using %d thread(s)\n", (int)jobs.size() - ctx.numfailed, (int)jobs.size(),
+				(int)fonts.size(), (unsigned long long)((gettime() - tstart) / 1000), numjobthreads);
+		result = ctx.numfailed > 0 ? 1 : 0;
+	}
+
+	DestroySharedOutlines(outlines);
+	UnloadFonts(fonts);
+	return result;
+}
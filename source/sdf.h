@@ -52,6 +52,14 @@ void sdfBuildDistanceFieldNoAlloc(unsigned char* out, int outstride, float radiu
 								  const unsigned char* img, int width, int height, int stride,
 								  unsigned char* temp);
 
+// Same as sdfBuildDistanceFieldNoAlloc, but outputs the signed distances as floats (in pixels, negative inside),
+// for encoding them with more than 8 bits.
+//   out - Output distances. Can be the start of 'temp' (with outstride == width).
+//   outstride - Floats per row on output image.
+void sdfBuildSignedDistancesNoAlloc(float* out, int outstride,
+									const unsigned char* img, int width, int height, int stride,
+									unsigned char* temp);
+
 // This function converts the antialiased image where each pixel represents coverage (box-filter
 // sampling of the ideal, crisp edge) to a distance field with narrow band radius of sqrt(2).
 // This is the fastest way to turn antialised image to contour texture. This function is good
@@ -192,12 +200,11 @@ static float sdf__distsqr(struct SDFpoint* a, struct SDFpoint* b)
 	return dx*dx + dy*dy;
 }
 
-void sdfBuildDistanceFieldNoAlloc(unsigned char* out, int outstride, float radius,
-								  const unsigned char* img, int width, int height, int stride,
-								  unsigned char* temp)
+void sdfBuildSignedDistancesNoAlloc(float* out, int outstride,
+									const unsigned char* img, int width, int height, int stride,
+									unsigned char* temp)
 {
 	int i, x, y, pass;
-	float scale;
 	float* tdist = (float*)&temp[0];
 	struct SDFpoint* tpt = (struct SDFpoint*)&temp[width * height * sizeof(float)];
 
@@ -360,16 +367,33 @@ void sdfBuildDistanceFieldNoAlloc(unsigned char* out, int outstride, float radiu
 		if (changed == 0) break;
 	}
 
+	// The same index is read and written, so 'out' can be 'tdist'
+	for (y = 0; y < height; y++) {
+		for (x = 0; x < width; x++) {
+			float d = sqrtf(tdist[x+y*width]);
+			if (img[x+y*stride] > 127) d = -d;
+			out[x+y*outstride] = d;
+		}
+	}
+}
+
+void sdfBuildDistanceFieldNoAlloc(unsigned char* out, int outstride, float radius,
+								  const unsigned char* img, int width, int height, int stride,
+								  unsigned char* temp)
+{
+	int x, y;
+	float scale;
+	float* dist = (float*)&temp[0];
+	sdfBuildSignedDistancesNoAlloc(dist, width, img, width, height, stride, temp);
+
 	// Map to good range.
 	scale = 1.0f / radius;
 	for (y = 0; y < height; y++) {
 		for (x = 0; x < width; x++) {
-			float d = sqrtf(tdist[x+y*width]) * scale;
-			if (img[x+y*stride] > 127) d = -d;
+			float d = dist[x+y*width] * scale;
 			out[x+y*outstride] = (unsigned char)(sdf__clamp01(0.5f - d*0.5f) * 255.0f);
 		}
 	}
-
 }
 
 int sdfBuildDistanceField(unsigned char* out, int outstride, float radius,
@@ -0,0 +1,1020 @@
+#ifndef SDF_ATLAS_H
+#define SDF_ATLAS_H
+
+/** Distance field glyphs, and a glyph atlas that generates them at runtime
+ *
+ * The sdf_glyph_* functions are the per glyph pipeline (outline -> rasterize -> distance transform -> downsample),
+ * shared by the offline generator (main.cpp) and the runtime atlas.
+ *
+ * The runtime atlas generates the glyphs when they are first requested, into a fixed size texture:
+ *
+ *	sdf_atlas* atlas = sdf_atlas_create(&params);
+ *	// Each frame
+ *	sdf_atlas_glyph glyph;
+ *	if( sdf_atlas_request_glyph(atlas, codepoint, &glyph) )
+ *		... draw the quad, using glyph.box ...
+ *	const sdf_atlas_rect* dirty;
+ *	int numdirty = sdf_atlas_flush(atlas, &dirty);
+ *	... upload the dirty rects of sdf_atlas_pixels() ...
+ *
+ * The texture is divided into shelves (rows), and each shelf into slots. When the texture is full,
+ * the least recently used glyphs are evicted, but never the ones requested since the last flush.
+ *
+ * With params.numthreads > 0, the glyphs are generated by worker threads instead, so a new glyph
+ * doesn't stall the frame. sdf_atlas_request_glyph returns SDF_ATLAS_GLYPH_PENDING until it's done,
+ * and sdf_atlas_collect publishes the finished glyphs, at most 'maxglyphs' per frame:
+ *
+ *	sdf_atlas_collect(atlas, 8);
+ *	int numdirty = sdf_atlas_flush(atlas, &dirty);
+ *
+ * The atlas itself is not thread safe: all the sdf_atlas_* calls have to be made from the same thread.
+ *
+ * Include it after stb_truetype.h. The declarations only need the stbtt_fontinfo type, so any source file can include it.
+ * The implementation uses the stb_truetype.h internals (stbtt__point, stbtt__rasterize): define SDF_ATLAS_IMPLEMENTATION
+ * before including it in one source file, the same one as STB_TRUETYPE_IMPLEMENTATION and SDF_IMPLEMENTATION.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef enum _sdf_algorithm
+{
+	SDF_ALGORITHM_EEDTAA3,		// jc_sdf_dr_eedtaa3: A single sweep pair, approximate
+	SDF_ALGORITHM_SDF,			// sdfBuildDistanceField: Sweep and update, up to SDF_MAX_PASSES passes
+	SDF_ALGORITHM_EDT,			// jc_sdf_edt: Exact, separable O(N)
+	SDF_ALGORITHM_VECTOR,		// jc_sdf_shape_render: Analytic distances to the glyph outline, no rasterization
+} sdf_algorithm;
+
+typedef struct _sdf_glyph_params
+{
+	float			scale;				// stbtt_ScaleForPixelHeight(font, fontsize * numoversampling)
+	int				radius;				// pixels
+	int				padding[4];			// left, top, right, bottom (pixels)
+	int				numoversampling;	// The glyph is rasterized at 2^(numoversampling-1) times the size, and then downsampled
+	sdf_algorithm	algorithm;
+	int				numchannels;		// 1 = sdf, 3 = msdf, 4 = msdf + sdf (the multi channel fields need the vector algorithm)
+	int				format;				// jc_sdf_format: The size and type of each channel. The runtime atlas is always JC_SDF_FORMAT_R8
+} sdf_glyph_params;
+
+typedef struct _sdf_glyph_outline
+{
+	int				glyph;
+	int				numcontours;
+	int*			contourlengths;
+	void*			points;			// stbtt__point*: The flattened contours, in font units
+	void*			shape;			// jc_sdf_shape*: The curves, for the vector algorithm (0 if the glyph has none)
+} sdf_glyph_outline;
+
+/** Reads the outline of a glyph.
+ * The contours are flattened for 'flattenscale', which is fine enough for the smaller scales too.
+ * The vector algorithm uses the curves instead.
+ */
+void sdf_glyph_outline_create(const stbtt_fontinfo* font, int glyph, const sdf_glyph_params* params, float flattenscale, sdf_glyph_outline* outline);
+
+void sdf_glyph_outline_free(sdf_glyph_outline* outline);
+
+static inline int sdf_glyph_outline_is_empty(const sdf_glyph_outline* outline)
+{
+	return outline->points == 0 && outline->shape == 0;
+}
+
+/** The size of the finished tile (pixels), including the padding and the radius on each side
+ */
+void sdf_glyph_tile_size(const stbtt_fontinfo* font, int glyph, const sdf_glyph_params* params, int* width, int* height);
+
+/** The placement of the tile, relative to the pen position and the base line (pixels)
+ */
+void sdf_glyph_metrics(const stbtt_fontinfo* font, int glyph, const sdf_glyph_params* params, float offset[2], float* advance, float* bearing_x);
+
+/** The size of the 'temp' buffer for sdf_glyph_transform, when the (oversampled) bitmap is at most maxbitmapsize x maxbitmapsize
+ */
+size_t sdf_glyph_temp_size(int maxbitmapsize);
+
+/** Rasterizes the glyph into 'bitmap' (tilewidth x tileheight, times the oversampling). Does nothing for the vector algorithm.
+ */
+void sdf_glyph_rasterize(const stbtt_fontinfo* font, const sdf_glyph_params* params, const sdf_glyph_outline* outline, int tilewidth, int tileheight, unsigned char* bitmap);
+
+/** Calculates the distance field from the rasterized 'bitmap' (or from the outline, for the vector algorithm),
+ * and writes the tile (tilewidth x tileheight x numchannels, tightly packed, in params->format) to 'out'.
+ * 'out' is also used while downsampling, so it needs to be as large as the oversampled tile.
+ */
+void sdf_glyph_transform(const stbtt_fontinfo* font, const sdf_glyph_params* params, const sdf_glyph_outline* outline, int tilewidth, int tileheight,
+						const unsigned char* bitmap, void* out, void* temp);
+
+
+typedef struct _sdf_atlas_params
+{
+	const stbtt_fontinfo*	font;			// Must stay valid for the lifetime of the atlas
+	int						fontsize;		// pixels
+	int						radius;			// pixels
+	int						padding;		// pixels, on each side
+	int						numoversampling;
+	int						numchannels;	// 1, 3 or 4. 3 and 4 use the vector algorithm
+	sdf_algorithm			algorithm;
+	int						width;			// The texture size
+	int						height;
+	int						numthreads;		// 0 generates the glyphs when they're requested
+} sdf_atlas_params;
+
+enum
+{
+	SDF_ATLAS_GLYPH_MISSING = 0,	// Not in the font, or no room for it right now
+	SDF_ATLAS_GLYPH_READY = 1,
+	SDF_ATLAS_GLYPH_PENDING = 2,	// Being generated. The box and metrics are valid, but the texels aren't there yet
+};
+
+typedef struct _sdf_atlas_glyph
+{
+	int		codepoint;
+	int		box[4];			// x0, y0, x1, y1 in the texture (pixels). Empty for glyphs without an outline (e.g. space)
+	float	offset[2];		// pixels
+	float	advance;		// pixels
+	float	bearing_x;		// pixels
+} sdf_atlas_glyph;
+
+typedef struct _sdf_atlas_rect
+{
+	int x, y, w, h;
+} sdf_atlas_rect;
+
+typedef struct _sdf_atlas sdf_atlas;
+
+/** Returns 0 if the parameters are invalid
+ */
+sdf_atlas* sdf_atlas_create(const sdf_atlas_params* params);
+
+void sdf_atlas_destroy(sdf_atlas* atlas);
+
+/** The texture, width * height * numchannels bytes
+ */
+const unsigned char* sdf_atlas_pixels(const sdf_atlas* atlas, int* width, int* height, int* numchannels);
+
+/** Gets the glyph for a code point, and generates it if it's not in the atlas already.
+ * Returns SDF_ATLAS_GLYPH_MISSING if the font doesn't have the glyph, or if there is no room, even after evicting
+ * all glyphs not requested since the last flush. With worker threads, new glyphs return SDF_ATLAS_GLYPH_PENDING
+ * until they have been collected.
+ */
+int sdf_atlas_request_glyph(sdf_atlas* atlas, int codepoint, sdf_atlas_glyph* outglyph);
+
+/** Publishes the glyphs finished by the worker threads: they become ready, and their rects are added to the
+ * dirty list. At most 'maxglyphs' glyphs are published (0 for no limit), to spread the texture uploads over
+ * several frames. Returns the number of glyphs published.
+ */
+int sdf_atlas_collect(sdf_atlas* atlas, int maxglyphs);
+
+/** Returns the rects of the texture that changed since the last flush (valid until the next request),
+ * and starts a new frame: glyphs requested before this point may now be evicted.
+ */
+int sdf_atlas_flush(sdf_atlas* atlas, const sdf_atlas_rect** dirty);
+
+#endif //SDF_ATLAS_H
+
+
+#ifdef SDF_ATLAS_IMPLEMENTATION
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "jc_sdf.h"
+#include "jc_sdf_shape.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+void sdf_glyph_outline_create(const stbtt_fontinfo* font, int glyph, const sdf_glyph_params* params, float flattenscale, sdf_glyph_outline* outline)
+{
+	memset(outline, 0, sizeof(sdf_glyph_outline));
+	outline->glyph = glyph;
+
+	stbtt_vertex* vertices = 0;
+	int numvertices = stbtt_GetGlyphShape(font, glyph, &vertices);
+	if( params->algorithm == SDF_ALGORITHM_VECTOR )
+	{
+		jc_sdf_shape shape;
+		jc_sdf_shape_from_stbtt(&shape, vertices, numvertices);
+		if( shape.numsegments > 0 )
+		{
+			if( params->numchannels > 1 )
+				jc_sdf_shape_color_edges(&shape, 3.0f);
+			outline->shape = malloc(sizeof(jc_sdf_shape));
+			memcpy(outline->shape, &shape, sizeof(jc_sdf_shape));
+		}
+		else
+			jc_sdf_shape_free(&shape);
+	}
+	else if( numvertices > 0 )
+	{
+		// Same flatness as stbtt_MakeGlyphBitmap
+		outline->points = (void*)stbtt_FlattenCurves(vertices, numvertices, 0.35f / flattenscale, &outline->contourlengths, &outline->numcontours, 0);
+	}
+	stbtt_FreeShape(font, vertices);
+}
+
+void sdf_glyph_outline_free(sdf_glyph_outline* outline)
+{
+	STBTT_free(outline->contourlengths, 0);
+	STBTT_free(outline->points, 0);
+	if( outline->shape )
+	{
+		jc_sdf_shape_free((jc_sdf_shape*)outline->shape);
+		free(outline->shape);
+	}
+	memset(outline, 0, sizeof(sdf_glyph_outline));
+}
+
+void sdf_glyph_tile_size(const stbtt_fontinfo* font, int glyph, const sdf_glyph_params* params, int* width, int* height)
+{
+	int bbox[4];
+	stbtt_GetGlyphBitmapBox(font, glyph, params->scale, params->scale, &bbox[0], &bbox[1], &bbox[2], &bbox[3]);
+	*width	= (bbox[2] - bbox[0]) / params->numoversampling + params->padding[0] + params->padding[2] + params->radius*2;
+	*height	= (bbox[3] - bbox[1]) / params->numoversampling + params->padding[1] + params->padding[3] + params->radius*2;
+}
+
+void sdf_glyph_metrics(const stbtt_fontinfo* font, int glyph, const sdf_glyph_params* params, float offset[2], float* advance, float* bearing_x)
+{
+	int iadvance, ibearingx;
+	stbtt_GetGlyphHMetrics(font, glyph, &iadvance, &ibearingx);
+
+	int x1, y1, x2, y2;
+	stbtt_GetGlyphBitmapBox(font, glyph, params->scale, params->scale, &x1, &y1, &x2, &y2);
+
+	offset[0]	= 0;
+	offset[1]	= y2 / params->numoversampling;
+	*advance	= (iadvance * params->scale) / params->numoversampling;
+	*bearing_x	= (ibearingx * params->scale) / params->numoversampling;
+}
+
+size_t sdf_glyph_temp_size(int maxbitmapsize)
+{
+	size_t size = (size_t)maxbitmapsize*maxbitmapsize*sizeof(float)*3;
+	if( size < JC_SDF_DR_EEDTAA3_TEMPSIZE(maxbitmapsize, maxbitmapsize) )
+		size = JC_SDF_DR_EEDTAA3_TEMPSIZE(maxbitmapsize, maxbitmapsize);
+	if( size < JC_SDF_EDT_TEMPSIZE(maxbitmapsize, maxbitmapsize) )
+		size = JC_SDF_EDT_TEMPSIZE(maxbitmapsize, maxbitmapsize);
+	return size;
+}
+
+// Same as stbtt_MakeGlyphBitmap, but with the contours already flattened
+static void _sdf_rasterize(const sdf_glyph_outline* outline, unsigned char* output, int width, int height, int stride, float scale, int ix0, int iy0)
+{
+	if( width <= 0 || height <= 0 || !outline->points )
+		return;
+	stbtt__bitmap gbm;
+	gbm.pixels = output;
+	gbm.w = width;
+	gbm.h = height;
+	gbm.stride = stride;
+	stbtt__rasterize(&gbm, (stbtt__point*)outline->points, outline->contourlengths, outline->numcontours, scale, scale, 0.0f, 0.0f, ix0, iy0, 1, 0);
+}
+
+static void _sdf_minify2x(void* image, uint32_t width, uint32_t height, jc_sdf_format format)
+{
+	uint32_t halfwidth = width / 2;
+	uint32_t halfheight = height / 2;
+	unsigned char* image8 = (unsigned char*)image;
+	uint16_t* image16 = (uint16_t*)image;
+	for( uint32_t ty = 0; ty < halfheight; ++ty)
+	{
+		for( uint32_t tx = 0; tx < halfwidth; ++tx)
+		{
+			uint32_t i0 = (ty*2+0) * width + tx*2;
+			uint32_t i1 = (ty*2+1) * width + tx*2;
+			uint32_t o = ty * halfwidth + tx;
+			if( format == JC_SDF_FORMAT_R8 )
+			{
+				float a = image8[i0];
+				float b = image8[i0 + 1];
+				float c = image8[i1];
+				float d = image8[i1 + 1];
+				image8[o] = (unsigned char)((a + b + c + d) / 4.0f);
+			}
+			else if( format == JC_SDF_FORMAT_R16 )
+				image16[o] = (uint16_t)((image16[i0] + image16[i0 + 1] + image16[i1] + image16[i1 + 1] + 2) / 4);
+			else
+				image16[o] = jc_sdf_float_to_half((jc_sdf_half_to_float(image16[i0]) + jc_sdf_half_to_float(image16[i0 + 1]) +
+													jc_sdf_half_to_float(image16[i1]) + jc_sdf_half_to_float(image16[i1 + 1])) * 0.25f);
+		}
+	}
+}
+
+void sdf_glyph_rasterize(const stbtt_fontinfo* font, const sdf_glyph_params* params, const sdf_glyph_outline* outline, int tilewidth, int tileheight, unsigned char* bitmap)
+{
+	const int* padding		= params->padding;
+	int numoversampling		= params->numoversampling;
+	int radius				= params->radius;
+
+	uint32_t bitmapwidth  	= tilewidth * numoversampling;
+	uint32_t bitmapheight	= tileheight * numoversampling;
+	if( params->algorithm == SDF_ALGORITHM_VECTOR )
+		return;
+	memset(bitmap, 0, bitmapwidth * bitmapheight);
+
+	// Since the bitmap is larger than the actual glyph, we need to offset the start
+	uint32_t bitmapoffset 	= ((padding[1] + radius) * numoversampling)  * bitmapwidth + (padding[0] + radius) * numoversampling;
+	uint32_t glyphwidth   	= bitmapwidth - padding[0] - padding[2] - radius*2;
+	uint32_t glyphheight	= bitmapheight - padding[1] - padding[3] - radius*2;
+
+	int ix0, iy0;
+	stbtt_GetGlyphBitmapBox(font, outline->glyph, params->scale, params->scale, &ix0, &iy0, 0, 0);
+	_sdf_rasterize(outline, bitmap + bitmapoffset, glyphwidth, glyphheight, bitmapwidth, params->scale, ix0, iy0);
+}
+
+void sdf_glyph_transform(const stbtt_fontinfo* font, const sdf_glyph_params* params, const sdf_glyph_outline* outline, int tilewidth, int tileheight,
+						const unsigned char* bitmap, void* out, void* temp)
+{
+	const int* padding		= params->padding;
+	int numoversampling		= params->numoversampling;
+	int radius				= params->radius;
+	jc_sdf_format format	= (jc_sdf_format)params->format;
+	uint32_t bitmapwidth  	= tilewidth * numoversampling;
+	uint32_t bitmapheight	= tileheight * numoversampling;
+
+	switch( params->algorithm )
+	{
+	case SDF_ALGORITHM_VECTOR:
+		{
+			// Same placement as stbtt_MakeGlyphBitmap
+			jc_sdf_shape empty = { 0, 0, 0 };
+			const jc_sdf_shape* shape = outline->shape ? (const jc_sdf_shape*)outline->shape : &empty;
+			int ix0, iy0;
+			stbtt_GetGlyphBitmapBox(font, outline->glyph, params->scale, params->scale, &ix0, &iy0, 0, 0);
+			jc_sdf_shape_render_channels(shape, params->scale, (float)(padding[0] + radius - ix0), (float)(padding[1] + radius - iy0),
+								out, bitmapwidth, bitmapheight, bitmapwidth * params->numchannels * JC_SDF_FORMAT_SIZE(format), params->numchannels, format, radius);
+		}
+		break;
+	case SDF_ALGORITHM_SDF:
+		{
+			// The distances are calculated in place, at the start of 'temp'
+			float* distances = (float*)temp;
+			sdfBuildSignedDistancesNoAlloc(distances, bitmapwidth, bitmap, bitmapwidth, bitmapheight, bitmapwidth, (unsigned char*)temp);
+			float scale = 1.0f / (radius*numoversampling);
+			for( uint32_t i = 0; i < bitmapwidth * bitmapheight; ++i )
+				jc_sdf_store(out, i, format, distances[i] * scale);
+		}
+		break;
+	case SDF_ALGORITHM_EDT:
+		jc_sdf_edt_noalloc(bitmap, bitmapwidth, bitmapheight, out, bitmapwidth, radius*numoversampling, format, temp);
+		break;
+	default:
+		jc_sdf_dr_eedtaa3_noalloc(bitmap, bitmapwidth, bitmapheight, out, bitmapwidth, radius*numoversampling, format, temp);
+		break;
+	}
+
+	for( int o = 1; o < numoversampling; ++o )
+		_sdf_minify2x(out, bitmapwidth, bitmapheight, format);
+}
+
+
+typedef struct _sdf_atlas_entry
+{
+	sdf_atlas_glyph	glyph;
+	int				shelf;		// -1 if it has no tile
+	int				slot;
+	int				lruprev;	// Towards the most recently used. Also the free list link
+	int				lrunext;
+	unsigned int	frame;		// The last frame it was requested
+	int				pending;	// Queued for a worker. Not in the LRU list, so it cannot be evicted
+} _sdf_atlas_entry;
+
+// A horizontal span of a shelf. The slots of a shelf form a list, ordered by x
+typedef struct _sdf_atlas_slot
+{
+	int x;
+	int w;
+	int entry;		// -1 if free
+	int next;		// The next slot in the shelf, or the next free slot struct
+} _sdf_atlas_slot;
+
+typedef struct _sdf_atlas_shelf
+{
+	int y;
+	int h;
+	int firstslot;	// -1 if empty
+	int right;		// Everything from here to the texture width is unused
+} _sdf_atlas_shelf;
+
+struct _sdf_atlas
+{
+	sdf_atlas_params	params;
+	sdf_glyph_params	glyphparams;
+	unsigned char*		pixels;
+
+	int**				lookup;			// [codepoint >> 8][codepoint & 255] -> entry, allocated on demand
+	_sdf_atlas_entry*	entries;
+	int					numentries;
+	int					capacity;
+	int					freeentry;		// -1 if none
+	int					lruhead;		// Most recently used (with a tile)
+	int					lrutail;
+	unsigned int		frame;
+
+	_sdf_atlas_slot*	slots;
+	int					numslots;
+	int					slotcapacity;
+	int					freeslot;
+	_sdf_atlas_shelf*	shelves;		// Ordered by y
+	int					numshelves;
+	int					shelfcapacity;
+
+	sdf_atlas_rect*		dirty;
+	int					numdirty;
+	int					dirtycapacity;
+
+	int					maxbitmapsize;
+	unsigned char*		bitmap;
+	unsigned char*		tile;
+	void*				temp;
+
+	struct _sdf_atlas_worker*	workers;
+	int					numworkers;
+	int					nextworker;		// Round robin
+	int					nextcollect;
+};
+
+#define _SDF_ATLAS_RING_SIZE	256		// Power of two
+
+typedef struct _sdf_atlas_job
+{
+	int entry;
+	int glyph;
+	int x, y, w, h;
+} _sdf_atlas_job;
+
+// Lock free, single producer / single consumer
+typedef struct _sdf_atlas_ring
+{
+	alignas(64) std::atomic<unsigned int>	head;	// Written by the consumer
+	alignas(64) std::atomic<unsigned int>	tail;	// Written by the producer
+	_sdf_atlas_job							jobs[_SDF_ATLAS_RING_SIZE];
+} _sdf_atlas_ring;
+
+static int _sdf_atlas_ring_push(_sdf_atlas_ring* ring, const _sdf_atlas_job* job)
+{
+	unsigned int tail = ring->tail.load(std::memory_order_relaxed);
+	if( tail - ring->head.load(std::memory_order_acquire) == _SDF_ATLAS_RING_SIZE )
+		return 0;
+	ring->jobs[tail & (_SDF_ATLAS_RING_SIZE-1)] = *job;
+	ring->tail.store(tail + 1, std::memory_order_release);
+	return 1;
+}
+
+static int _sdf_atlas_ring_pop(_sdf_atlas_ring* ring, _sdf_atlas_job* job)
+{
+	unsigned int head = ring->head.load(std::memory_order_relaxed);
+	if( head == ring->tail.load(std::memory_order_acquire) )
+		return 0;
+	*job = ring->jobs[head & (_SDF_ATLAS_RING_SIZE-1)];
+	ring->head.store(head + 1, std::memory_order_release);
+	return 1;
+}
+
+static int _sdf_atlas_ring_empty(_sdf_atlas_ring* ring)
+{
+	return ring->head.load(std::memory_order_acquire) == ring->tail.load(std::memory_order_acquire);
+}
+
+/* Each worker has its own rings, so that both are single producer / single consumer:
+ * 'jobs' goes from the atlas thread to the worker, 'done' from the worker back to the atlas thread.
+ * The worker writes the tile straight into the slot reserved for it, which no one else touches until
+ * the glyph is published.
+ */
+struct _sdf_atlas_worker
+{
+	sdf_atlas*				atlas;
+	_sdf_atlas_ring			jobs;
+	_sdf_atlas_ring			done;
+	std::mutex				mutex;		// Only for sleeping when there are no jobs
+	std::condition_variable	wakeup;
+	std::atomic<int>		quit;
+	std::thread				thread;
+	unsigned char*			bitmap;
+	unsigned char*			tile;
+	void*					temp;
+};
+
+#define _SDF_ATLAS_NUM_PAGES		((0x10FFFF >> 8) + 1)
+#define _SDF_ATLAS_SHELF_ROUNDING	4
+
+#define _SDF_ATLAS_GROW(_PTR, _COUNT, _CAPACITY, _TYPE)												\
+	if( (_COUNT) == (_CAPACITY) )																	\
+	{																								\
+		(_CAPACITY) = (_CAPACITY) ? (_CAPACITY) * 2 : 64;											\
+		(_PTR) = (_TYPE*)realloc((_PTR), (_CAPACITY) * sizeof(_TYPE));								\
+	}
+
+// Generates the tile into the atlas texture
+static void _sdf_atlas_render(sdf_atlas* atlas, const _sdf_atlas_job* job, unsigned char* bitmap, unsigned char* tile, void* temp)
+{
+	const stbtt_fontinfo* font = atlas->params.font;
+	const sdf_glyph_params* gp = &atlas->glyphparams;
+	sdf_glyph_outline outline;
+	sdf_glyph_outline_create(font, job->glyph, gp, gp->scale, &outline);
+	sdf_glyph_rasterize(font, gp, &outline, job->w, job->h, bitmap);
+	sdf_glyph_transform(font, gp, &outline, job->w, job->h, bitmap, tile, temp);
+	sdf_glyph_outline_free(&outline);
+
+	int nc = atlas->params.numchannels;
+	for( int ty = 0; ty < job->h; ++ty )
+		memcpy(atlas->pixels + ((size_t)(job->y + ty) * atlas->params.width + job->x) * nc, tile + (size_t)ty * job->w * nc, (size_t)job->w * nc);
+}
+
+static void _sdf_atlas_worker_main(_sdf_atlas_worker* worker)
+{
+	_sdf_atlas_job job;
+	while( !worker->quit )
+	{
+		if( !_sdf_atlas_ring_pop(&worker->jobs, &job) )
+		{
+			std::unique_lock<std::mutex> lock(worker->mutex);
+			worker->wakeup.wait(lock, [worker]{ return worker->quit || !_sdf_atlas_ring_empty(&worker->jobs); });
+			continue;
+		}
+
+		_sdf_atlas_render(worker->atlas, &job, worker->bitmap, worker->tile, worker->temp);
+
+		// The atlas thread publishes at its own pace, so wait for room
+		while( !worker->quit && !_sdf_atlas_ring_push(&worker->done, &job) )
+			std::this_thread::yield();
+	}
+}
+
+sdf_atlas* sdf_atlas_create(const sdf_atlas_params* params)
+{
+	if( params->width <= 0 || params->height <= 0 || params->radius < 1 )
+		return 0;
+
+	sdf_atlas* atlas = (sdf_atlas*)malloc(sizeof(sdf_atlas));
+	memset(atlas, 0, sizeof(sdf_atlas));
+	atlas->params = *params;
+	if( atlas->params.numoversampling < 1 )
+		atlas->params.numoversampling = 1;
+	if( atlas->params.numchannels != 3 && atlas->params.numchannels != 4 )
+		atlas->params.numchannels = 1;
+	if( atlas->params.numchannels > 1 )
+		atlas->params.algorithm = SDF_ALGORITHM_VECTOR;
+	if( atlas->params.algorithm == SDF_ALGORITHM_VECTOR )
+		atlas->params.numoversampling = 1;
+
+	sdf_glyph_params* gp = &atlas->glyphparams;
+	gp->scale			= stbtt_ScaleForPixelHeight(params->font, atlas->params.fontsize * atlas->params.numoversampling);
+	gp->radius			= atlas->params.radius;
+	gp->padding[0]		= gp->padding[1] = gp->padding[2] = gp->padding[3] = atlas->params.padding;
+	gp->numoversampling	= atlas->params.numoversampling;
+	gp->algorithm		= atlas->params.algorithm;
+	gp->numchannels		= atlas->params.numchannels;
+	gp->format			= JC_SDF_FORMAT_R8;
+
+	size_t size = (size_t)params->width * params->height * atlas->params.numchannels;
+	atlas->pixels = (unsigned char*)malloc(size);
+	memset(atlas->pixels, 0, size);
+	atlas->lookup = (int**)calloc(_SDF_ATLAS_NUM_PAGES, sizeof(int*));
+	atlas->freeentry = -1;
+	atlas->lruhead = -1;
+	atlas->lrutail = -1;
+	atlas->freeslot = -1;
+
+	// The scratch buffers fit any glyph in the font
+	int x0, y0, x1, y1;
+	stbtt_GetFontBoundingBox(params->font, &x0, &y0, &x1, &y1);
+	int maxw = (int)((x1 - x0) * gp->scale) + 2;
+	int maxh = (int)((y1 - y0) * gp->scale) + 2;
+	int maxsize = (maxw > maxh ? maxw : maxh) + (atlas->params.padding + atlas->params.radius) * 2 * atlas->params.numoversampling;
+	atlas->maxbitmapsize = maxsize;
+	atlas->bitmap	= (unsigned char*)malloc((size_t)maxsize * maxsize);
+	atlas->tile		= (unsigned char*)malloc((size_t)maxsize * maxsize * 4);
+	atlas->temp		= malloc(sdf_glyph_temp_size(maxsize));
+
+	if( params->numthreads > 0 )
+	{
+		atlas->numworkers = params->numthreads;
+		atlas->workers = new _sdf_atlas_worker[atlas->numworkers];
+		for( int i = 0; i < atlas->numworkers; ++i )
+		{
+			_sdf_atlas_worker* worker = &atlas->workers[i];
+			worker->atlas		= atlas;
+			worker->jobs.head	= worker->jobs.tail = 0;
+			worker->done.head	= worker->done.tail = 0;
+			worker->quit		= 0;
+			worker->bitmap		= (unsigned char*)malloc((size_t)maxsize * maxsize);
+			worker->tile		= (unsigned char*)malloc((size_t)maxsize * maxsize * 4);
+			worker->temp		= malloc(sdf_glyph_temp_size(maxsize));
+			worker->thread		= std::thread(_sdf_atlas_worker_main, worker);
+		}
+	}
+	return atlas;
+}
+
+void sdf_atlas_destroy(sdf_atlas* atlas)
+{
+	if( !atlas )
+		return;
+	for( int i = 0; i < atlas->numworkers; ++i )
+	{
+		_sdf_atlas_worker* worker = &atlas->workers[i];
+		{
+			std::lock_guard<std::mutex> lock(worker->mutex);
+			worker->quit = 1;
+		}
+		worker->wakeup.notify_one();
+		worker->thread.join();
+		free(worker->bitmap);
+		free(worker->tile);
+		free(worker->temp);
+	}
+	delete[] atlas->workers;
+	for( int i = 0; i < _SDF_ATLAS_NUM_PAGES; ++i )
+		free(atlas->lookup[i]);
+	free(atlas->lookup);
+	free(atlas->entries);
+	free(atlas->slots);
+	free(atlas->shelves);
+	free(atlas->dirty);
+	free(atlas->pixels);
+	free(atlas->bitmap);
+	free(atlas->tile);
+	free(atlas->temp);
+	free(atlas);
+}
+
+const unsigned char* sdf_atlas_pixels(const sdf_atlas* atlas, int* width, int* height, int* numchannels)
+{
+	if( width )			*width = atlas->params.width;
+	if( height )		*height = atlas->params.height;
+	if( numchannels )	*numchannels = atlas->params.numchannels;
+	return atlas->pixels;
+}
+
+static int* _sdf_atlas_lookup(sdf_atlas* atlas, int codepoint, int create)
+{
+	int page = codepoint >> 8;
+	if( !atlas->lookup[page] )
+	{
+		if( !create )
+			return 0;
+		atlas->lookup[page] = (int*)malloc(256 * sizeof(int));
+		for( int i = 0; i < 256; ++i )
+			atlas->lookup[page][i] = -1;
+	}
+	return &atlas->lookup[page][codepoint & 255];
+}
+
+static void _sdf_atlas_lru_unlink(sdf_atlas* atlas, int index)
+{
+	_sdf_atlas_entry* e = &atlas->entries[index];
+	if( e->lruprev >= 0 )	atlas->entries[e->lruprev].lrunext = e->lrunext;
+	else					atlas->lruhead = e->lrunext;
+	if( e->lrunext >= 0 )	atlas->entries[e->lrunext].lruprev = e->lruprev;
+	else					atlas->lrutail = e->lruprev;
+	e->lruprev = e->lrunext = -1;
+}
+
+static void _sdf_atlas_lru_push_front(sdf_atlas* atlas, int index)
+{
+	_sdf_atlas_entry* e = &atlas->entries[index];
+	e->lruprev = -1;
+	e->lrunext = atlas->lruhead;
+	if( atlas->lruhead >= 0 )
+		atlas->entries[atlas->lruhead].lruprev = index;
+	atlas->lruhead = index;
+	if( atlas->lrutail < 0 )
+		atlas->lrutail = index;
+}
+
+static int _sdf_atlas_new_slot(sdf_atlas* atlas, int x, int w, int next)
+{
+	int index = atlas->freeslot;
+	if( index >= 0 )
+		atlas->freeslot = atlas->slots[index].next;
+	else
+	{
+		_SDF_ATLAS_GROW(atlas->slots, atlas->numslots, atlas->slotcapacity, _sdf_atlas_slot);
+		index = atlas->numslots++;
+	}
+	atlas->slots[index].x = x;
+	atlas->slots[index].w = w;
+	atlas->slots[index].entry = -1;
+	atlas->slots[index].next = next;
+	return index;
+}
+
+static void _sdf_atlas_delete_slot(sdf_atlas* atlas, int index)
+{
+	atlas->slots[index].next = atlas->freeslot;
+	atlas->freeslot = index;
+}
+
+// Finds room for w pixels in the shelf. Returns the slot, or -1
+static int _sdf_atlas_shelf_alloc(sdf_atlas* atlas, int shelfindex, int w)
+{
+	_sdf_atlas_shelf* shelf = &atlas->shelves[shelfindex];
+
+	// The best fitting free slot
+	int best = -1;
+	int prev = -1;
+	for( int s = shelf->firstslot; s >= 0; s = atlas->slots[s].next )
+	{
+		const _sdf_atlas_slot* slot = &atlas->slots[s];
+		if( slot->entry < 0 && slot->w >= w && (best < 0 || slot->w < atlas->slots[best].w) )
+			best = s;
+		prev = s;
+	}
+	if( best >= 0 )
+	{
+		_sdf_atlas_slot* slot = &atlas->slots[best];
+		if( slot->w > w )
+		{
+			int rest = _sdf_atlas_new_slot(atlas, slot->x + w, slot->w - w, slot->next);
+			slot = &atlas->slots[best];
+			slot->w = w;
+			slot->next = rest;
+		}
+		return best;
+	}
+
+	if( shelf->right + w > atlas->params.width )
+		return -1;
+	int index = _sdf_atlas_new_slot(atlas, shelf->right, w, -1);
+	if( prev >= 0 )
+		atlas->slots[prev].next = index;
+	else
+		atlas->shelves[shelfindex].firstslot = index;
+	atlas->shelves[shelfindex].right += w;
+	return index;
+}
+
+static int _sdf_atlas_alloc(sdf_atlas* atlas, int w, int h, int* outshelf)
+{
+	// Use the existing shelves, as long as they don't waste too much height
+	for( int i = 0; i < atlas->numshelves; ++i )
+	{
+		const _sdf_atlas_shelf* shelf = &atlas->shelves[i];
+		int empty = shelf->firstslot < 0;
+		if( shelf->h < h || (!empty && shelf->h > h + h / 4 + _SDF_ATLAS_SHELF_ROUNDING) )
+			continue;
+		int slot = _sdf_atlas_shelf_alloc(atlas, i, w);
+		if( slot >= 0 )
+		{
+			*outshelf = i;
+			return slot;
+		}
+	}
+
+	// A new shelf at the bottom
+	int bottom = atlas->numshelves ? atlas->shelves[atlas->numshelves-1].y + atlas->shelves[atlas->numshelves-1].h : 0;
+	int shelfh = (h + _SDF_ATLAS_SHELF_ROUNDING - 1) / _SDF_ATLAS_SHELF_ROUNDING * _SDF_ATLAS_SHELF_ROUNDING;
+	if( bottom + shelfh > atlas->params.height )
+		shelfh = atlas->params.height - bottom;
+	if( shelfh < h || w > atlas->params.width )
+		return -1;
+
+	_SDF_ATLAS_GROW(atlas->shelves, atlas->numshelves, atlas->shelfcapacity, _sdf_atlas_shelf);
+	_sdf_atlas_shelf* shelf = &atlas->shelves[atlas->numshelves++];
+	shelf->y = bottom;
+	shelf->h = shelfh;
+	shelf->firstslot = -1;
+	shelf->right = 0;
+	*outshelf = atlas->numshelves - 1;
+	return _sdf_atlas_shelf_alloc(atlas, *outshelf, w);
+}
+
+// Frees the slot, merges it with its free neighbours, and merges empty shelves
+static void _sdf_atlas_free_slot(sdf_atlas* atlas, int shelfindex, int slotindex)
+{
+	_sdf_atlas_shelf* shelf = &atlas->shelves[shelfindex];
+	atlas->slots[slotindex].entry = -1;
+
+	int prev = -1;
+	for( int s = shelf->firstslot; s >= 0 && s != slotindex; s = atlas->slots[s].next )
+		prev = s;
+
+	_sdf_atlas_slot* slot = &atlas->slots[slotindex];
+	int next = slot->next;
+	if( next >= 0 && atlas->slots[next].entry < 0 )
+	{
+		slot->w += atlas->slots[next].w;
+		slot->next = atlas->slots[next].next;
+		_sdf_atlas_delete_slot(atlas, next);
+	}
+	if( prev >= 0 && atlas->slots[prev].entry < 0 )
+	{
+		atlas->slots[prev].w += slot->w;
+		atlas->slots[prev].next = slot->next;
+		_sdf_atlas_delete_slot(atlas, slotindex);
+		slotindex = prev;
+		slot = &atlas->slots[prev];
+		for( prev = -1, next = shelf->firstslot; next >= 0 && next != slotindex; next = atlas->slots[next].next )
+			prev = next;
+	}
+
+	// A free slot at the end goes back to the unused part
+	if( slot->next < 0 )
+	{
+		shelf->right = slot->x;
+		if( prev >= 0 )
+			atlas->slots[prev].next = -1;
+		else
+			shelf->firstslot = -1;
+		_sdf_atlas_delete_slot(atlas, slotindex);
+	}
+
+	if( shelf->firstslot >= 0 )
+		return;
+
+	// Merge the empty shelf with the empty ones below and above, so taller glyphs can use the space
+	int first = shelfindex;
+	int last = shelfindex;
+	while( first > 0 && atlas->shelves[first-1].firstslot < 0 )
+		--first;
+	while( last + 1 < atlas->numshelves && atlas->shelves[last+1].firstslot < 0 )
+		++last;
+	if( last == atlas->numshelves - 1 )
+	{
+		atlas->numshelves = first;	// The bottom is unused anyway
+	}
+	else if( last > first )
+	{
+		atlas->shelves[first].h = atlas->shelves[last].y + atlas->shelves[last].h - atlas->shelves[first].y;
+		int removed = last - first;
+		memmove(&atlas->shelves[first+1], &atlas->shelves[last+1], (atlas->numshelves - last - 1) * sizeof(_sdf_atlas_shelf));
+		atlas->numshelves -= removed;
+		for( int e = 0; e < atlas->numentries; ++e )
+		{
+			if( atlas->entries[e].shelf > last )
+				atlas->entries[e].shelf -= removed;
+		}
+	}
+}
+
+static void _sdf_atlas_evict(sdf_atlas* atlas, int index)
+{
+	_sdf_atlas_entry* e = &atlas->entries[index];
+	_sdf_atlas_lru_unlink(atlas, index);
+	if( e->shelf >= 0 )
+		_sdf_atlas_free_slot(atlas, e->shelf, e->slot);
+	*_sdf_atlas_lookup(atlas, e->glyph.codepoint, 0) = -1;
+	e->shelf = -1;
+	e->lruprev = atlas->freeentry;	// The free list link
+	atlas->freeentry = index;
+}
+
+static void _sdf_atlas_add_dirty(sdf_atlas* atlas, int x, int y, int w, int h)
+{
+	_SDF_ATLAS_GROW(atlas->dirty, atlas->numdirty, atlas->dirtycapacity, sdf_atlas_rect);
+	sdf_atlas_rect r = { x, y, w, h };
+	atlas->dirty[atlas->numdirty++] = r;
+}
+
+// Finds room for the tile, evicting the least recently used glyphs if needed. Returns the slot, or -1
+static int _sdf_atlas_reserve(sdf_atlas* atlas, int w, int h, int* shelf)
+{
+	int slot = _sdf_atlas_alloc(atlas, w, h, shelf);
+	while( slot < 0 && atlas->lrutail >= 0 && atlas->entries[atlas->lrutail].frame != atlas->frame )
+	{
+		_sdf_atlas_evict(atlas, atlas->lrutail);
+		slot = _sdf_atlas_alloc(atlas, w, h, shelf);
+	}
+	return slot;
+}
+
+int sdf_atlas_request_glyph(sdf_atlas* atlas, int codepoint, sdf_atlas_glyph* outglyph)
+{
+	if( codepoint < 0 || codepoint > 0x10FFFF )
+		return SDF_ATLAS_GLYPH_MISSING;
+
+	int* lookup = _sdf_atlas_lookup(atlas, codepoint, 0);
+	if( lookup && *lookup >= 0 )
+	{
+		int index = *lookup;
+		_sdf_atlas_entry* e = &atlas->entries[index];
+		e->frame = atlas->frame;
+		if( !e->pending && atlas->lruhead != index )
+		{
+			_sdf_atlas_lru_unlink(atlas, index);
+			_sdf_atlas_lru_push_front(atlas, index);
+		}
+		if( outglyph )
+			*outglyph = e->glyph;
+		return e->pending ? SDF_ATLAS_GLYPH_PENDING : SDF_ATLAS_GLYPH_READY;
+	}
+
+	const stbtt_fontinfo* font = atlas->params.font;
+	int glyph = stbtt_FindGlyphIndex(font, codepoint);
+	if( glyph == 0 )
+		return SDF_ATLAS_GLYPH_MISSING;
+
+	const sdf_glyph_params* gp = &atlas->glyphparams;
+	int w = 0, h = 0, shelf = -1, slot = -1;
+	int pending = 0;
+	if( !stbtt_IsGlyphEmpty(font, glyph) )
+	{
+		sdf_glyph_tile_size(font, glyph, gp, &w, &h);
+		if( w * gp->numoversampling > atlas->maxbitmapsize || h * gp->numoversampling > atlas->maxbitmapsize )
+			return SDF_ATLAS_GLYPH_MISSING;
+
+		_sdf_atlas_worker* worker = 0;
+		for( int i = 0; i < atlas->numworkers && !worker; ++i )
+		{
+			_sdf_atlas_worker* candidate = &atlas->workers[(atlas->nextworker + i) % atlas->numworkers];
+			if( candidate->jobs.tail.load(std::memory_order_relaxed) - candidate->jobs.head.load(std::memory_order_acquire) < _SDF_ATLAS_RING_SIZE )
+				worker = candidate;
+		}
+		if( atlas->numworkers && !worker )
+			return SDF_ATLAS_GLYPH_MISSING;	// All queues are full, try again next frame
+
+		slot = _sdf_atlas_reserve(atlas, w, h, &shelf);
+		if( slot < 0 )
+			return SDF_ATLAS_GLYPH_MISSING;
+
+		_sdf_atlas_job job;
+		job.entry	= atlas->freeentry >= 0 ? atlas->freeentry : atlas->numentries;	// The entry allocated below
+		job.glyph	= glyph;
+		job.x		= atlas->slots[slot].x;
+		job.y		= atlas->shelves[shelf].y;
+		job.w		= w;
+		job.h		= h;
+		if( worker )
+		{
+			_sdf_atlas_ring_push(&worker->jobs, &job);
+			{
+				std::lock_guard<std::mutex> lock(worker->mutex);
+			}
+			worker->wakeup.notify_one();
+			atlas->nextworker = (int)(worker - atlas->workers + 1) % atlas->numworkers;
+			pending = 1;
+		}
+		else
+		{
+			_sdf_atlas_render(atlas, &job, atlas->bitmap, atlas->tile, atlas->temp);
+			_sdf_atlas_add_dirty(atlas, job.x, job.y, w, h);
+		}
+	}
+
+	int index = atlas->freeentry;
+	if( index >= 0 )
+		atlas->freeentry = atlas->entries[index].lruprev;
+	else
+	{
+		_SDF_ATLAS_GROW(atlas->entries, atlas->numentries, atlas->capacity, _sdf_atlas_entry);
+		index = atlas->numentries++;
+	}
+
+	_sdf_atlas_entry* e = &atlas->entries[index];
+	e->glyph.codepoint = codepoint;
+	e->glyph.box[0] = shelf >= 0 ? atlas->slots[slot].x : 0;
+	e->glyph.box[1] = shelf >= 0 ? atlas->shelves[shelf].y : 0;
+	e->glyph.box[2] = e->glyph.box[0] + w;
+	e->glyph.box[3] = e->glyph.box[1] + h;
+	sdf_glyph_metrics(font, glyph, gp, e->glyph.offset, &e->glyph.advance, &e->glyph.bearing_x);
+	e->shelf = shelf;
+	e->slot = slot;
+	e->frame = atlas->frame;
+	e->pending = pending;
+	e->lruprev = e->lrunext = -1;
+	if( !pending )
+		_sdf_atlas_lru_push_front(atlas, index);
+	if( shelf >= 0 )
+		atlas->slots[slot].entry = index;
+
+	*_sdf_atlas_lookup(atlas, codepoint, 1) = index;
+	if( outglyph )
+		*outglyph = e->glyph;
+	return pending ? SDF_ATLAS_GLYPH_PENDING : SDF_ATLAS_GLYPH_READY;
+}
+
+int sdf_atlas_collect(sdf_atlas* atlas, int maxglyphs)
+{
+	int count = 0;
+	int numidle = 0;
+	_sdf_atlas_job job;
+	while( atlas->numworkers && numidle < atlas->numworkers && (maxglyphs <= 0 || count < maxglyphs) )
+	{
+		_sdf_atlas_worker* worker = &atlas->workers[atlas->nextcollect];
+		atlas->nextcollect = (atlas->nextcollect + 1) % atlas->numworkers;
+		if( !_sdf_atlas_ring_pop(&worker->done, &job) )
+		{
+			++numidle;
+			continue;
+		}
+		numidle = 0;
+
+		_sdf_atlas_entry* e = &atlas->entries[job.entry];
+		e->pending = 0;
+		_sdf_atlas_lru_push_front(atlas, job.entry);
+		_sdf_atlas_add_dirty(atlas, job.x, job.y, job.w, job.h);
+		++count;
+	}
+	return count;
+}
+
+int sdf_atlas_flush(sdf_atlas* atlas, const sdf_atlas_rect** dirty)
+{
+	int numdirty = atlas->numdirty;
+	if( dirty )
+		*dirty = atlas->dirty;
+	atlas->numdirty = 0;
+	atlas->frame++;
+	return numdirty;
+}
+
+#endif //SDF_ATLAS_IMPLEMENTATION